@@ -0,0 +1,1455 @@
+// pcpack.cpp - Ultimate Spider-Man PCPACK core library, see pcpack.h
+
+#include "pcpack.h"
+
+#include <cstdio>
+#include <cctype>
+#include <array>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cerrno>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+namespace pcpack {
+
+// ==================== Type Extension Table ====================
+
+const char* const resource_type_ext[NUM_RESOURCE_TYPES] = {
+    ".NONE",     // 0
+    ".PCANIM",   // 1
+    ".PCSKEL",   // 2
+    ".ALS",      // 3
+    ".ENT",      // 4
+    ".ENTEXT",   // 5
+    ".DDS",      // 6
+    ".DDSMP",    // 7
+    ".IFL",      // 8
+    ".DESC",     // 9
+    ".ENS",      // 10
+    ".SPL",      // 11
+    ".AB",       // 12
+    ".QP",       // 13
+    ".TRIG",     // 14
+    ".PCSX",     // 15
+    ".INST",     // 16
+    ".FDF",      // 17
+    ".PANEL",    // 18
+    ".TXT",      // 19
+    ".ICN",      // 20
+    ".PCMESH",   // 21
+    ".PCMORPH",  // 22
+    ".PCMAT",    // 23
+    ".COLL",     // 24
+    ".PCPACK",   // 25
+    ".PCSANIM",  // 26
+    ".MSN",      // 27
+    ".MARKER",   // 28
+    ".HH",       // 29
+    ".WAV",      // 30
+    ".WBK",      // 31
+    ".M2V",      // 32
+    "M2V",       // 33
+    ".PFX",      // 34
+    ".CSV",      // 35
+    ".CLE",      // 36
+    ".LIT",      // 37
+    ".GRD",      // 38
+    ".GLS",      // 39
+    ".LOD",      // 40
+    ".SIN",      // 41
+    ".GV",       // 42
+    ".SV",       // 43
+    ".TOKENS",   // 44
+    ".DSG",      // 45
+    ".PATH",     // 46
+    ".PTRL",     // 47
+    ".LANG",     // 48
+    ".SLF",      // 49
+    ".VISEME",   // 50
+    ".PCMESHDEF",// 51
+    ".PCMORPHDEF",// 52
+    ".PCMATDEF", // 53
+    ".MUT",      // 54
+    ".ASG",      // 55
+    ".BAI",      // 56
+    ".CUT",      // 57
+    ".INTERACT", // 58
+    ".CSV",      // 59
+    ".CSV",      // 60
+    "._ENTID_",  // 61
+    "._ANIMID_", // 62
+    "._REGIONID_",// 63
+    "._AI_GENERIC_ID_",// 64
+    "._RADIOMSG_",// 65
+    "._GOAL_",   // 66
+    "._IFC_ATTRIBUTE_",// 67
+    "._SIGNAL_", // 68
+    "._PACKGROUP_"// 69
+};
+
+const char* get_ext(uint32_t type) {
+    return (type < (uint32_t)NUM_RESOURCE_TYPES) ? resource_type_ext[type] : ".UNK";
+}
+
+static std::string to_lower(std::string s) {
+    for (char& c : s) c = (char)tolower((unsigned char)c);
+    return s;
+}
+
+int type_from_ext(const std::string& ext) {
+    std::string l = to_lower(ext);
+    for (int i = 0; i < NUM_RESOURCE_TYPES; ++i) {
+        if (to_lower(resource_type_ext[i]) == l) return i;
+    }
+    return -1;
+}
+
+// ==================== Helpers ====================
+
+size_t align_up(size_t x, size_t a) {
+    if (a <= 1) return x;
+    size_t m = x % a;
+    return m ? x + (a - m) : x;
+}
+
+std::string sanitize_filename(const std::string& name) {
+    std::string result = name;
+    for (char& c : result) {
+        if (c < 32 || c == ':' || c == '*' || c == '?' || c == '"' ||
+            c == '<' || c == '>' || c == '|' || c == '/' || c == '\\')
+            c = '_';
+    }
+    return result;
+}
+
+// ==================== Trace ====================
+
+static std::atomic<bool> g_trace_on{false};
+static std::atomic<uint32_t> g_trace_threads{0};
+static std::mutex g_trace_mutex;
+static std::vector<TraceEvent> g_trace;
+static std::chrono::steady_clock::time_point g_trace_t0;
+
+static int64_t trace_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_trace_t0).count();
+}
+
+// Small ids in order of first use, so the viewer shows main, then workers
+static uint32_t trace_tid() {
+    thread_local uint32_t tid = ++g_trace_threads;
+    return tid;
+}
+
+void trace_start() {
+    g_trace_t0 = std::chrono::steady_clock::now();
+    trace_tid();
+    g_trace_on.store(true, std::memory_order_release);
+}
+
+bool trace_enabled() {
+    return g_trace_on.load(std::memory_order_relaxed);
+}
+
+std::vector<TraceEvent> trace_events() {
+    std::vector<TraceEvent> v;
+    {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        v = g_trace;
+    }
+    std::stable_sort(v.begin(), v.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.start_us < b.start_us; });
+    return v;
+}
+
+static std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if ((unsigned char)c < 0x20) {
+            char u[8];
+            snprintf(u, sizeof(u), "\\u%04x", (unsigned)(unsigned char)c);
+            out += u;
+        }
+        else out += c;
+    }
+    return out;
+}
+
+void write_trace(const fs::path& path) {
+    std::vector<TraceEvent> events = trace_events();
+    std::ofstream of(path, std::ios::binary);
+    if (!of) throw std::runtime_error("Cannot write: " + path.string());
+    of << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    uint32_t threads = g_trace_threads.load();
+    for (uint32_t t = 1; t <= threads; ++t) {
+        of << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":\""
+           << (t == 1 ? std::string("main") : "worker " + std::to_string(t - 1)) << "\"}},\n";
+    }
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& e = events[i];
+        of << "{\"name\":\"" << e.name << "\",\"cat\":\"pcpack\",\"ph\":\"X\",\"ts\":" << e.start_us
+           << ",\"dur\":" << e.dur_us << ",\"pid\":1,\"tid\":" << e.tid;
+        if (!e.detail.empty()) of << ",\"args\":{\"detail\":\"" << json_escape(e.detail) << "\"}";
+        of << (i + 1 < events.size() ? "},\n" : "}\n");
+    }
+    of << "]}\n";
+    of.close();
+    if (!of) throw std::runtime_error("Write failed: " + path.string());
+}
+
+TraceScope::TraceScope(const char* name, std::string_view detail) {
+    if (!name || !trace_enabled()) return;
+    this->name = name;
+    this->detail = detail;
+    start_us = trace_now_us();
+}
+
+TraceScope::~TraceScope() {
+    if (start_us < 0) return;
+    TraceEvent e{ name, std::move(detail), start_us, trace_now_us() - start_us, trace_tid() };
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    g_trace.push_back(std::move(e));
+}
+
+// ==================== Name Hash ====================
+
+uint32_t hash_string(std::string_view name) {
+    uint32_t h = 0;
+    for (unsigned char c : name) h = h * 33 + (uint32_t)tolower(c);
+    return h;
+}
+
+void hash_strings(const std::string_view* names, size_t count, uint32_t* out) {
+    static const std::array<uint8_t, 256> lower = [] {
+        std::array<uint8_t, 256> t{};
+        for (int c = 0; c < 256; ++c) t[c] = (uint8_t)tolower(c);
+        return t;
+    }();
+    for (size_t i = 0; i < count; i += HASH_LANES) {
+        const size_t m = std::min(HASH_LANES, count - i);
+        uint32_t h[HASH_LANES] = {};
+        uint32_t len[HASH_LANES] = {};
+        const uint8_t* p[HASH_LANES] = {};
+        size_t max_len = 0;
+        for (size_t l = 0; l < m; ++l) {
+            p[l] = (const uint8_t*)names[i + l].data();
+            len[l] = (uint32_t)names[i + l].size();
+            max_len = std::max<size_t>(max_len, len[l]);
+        }
+        for (uint32_t k = 0; k < max_len; ++k) {
+            uint32_t c[HASH_LANES];
+            for (size_t l = 0; l < HASH_LANES; ++l)
+                c[l] = k < len[l] ? lower[p[l][k]] : 0;
+            for (size_t l = 0; l < HASH_LANES; ++l)
+                h[l] = k < len[l] ? h[l] * 33 + c[l] : h[l];
+        }
+        for (size_t l = 0; l < m; ++l) out[i + l] = h[l];
+    }
+}
+
+// ==================== Content Hash ====================
+
+uint64_t xxh64(const void* data, size_t len) {
+    Xxh64 s;
+    s.update(data, len);
+    return s.digest();
+}
+
+uint64_t xxh64_file(const fs::path& path, std::vector<char>& buf) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open: " + path.string());
+    Xxh64 s;
+    while (in) {
+        in.read(buf.data(), buf.size());
+        s.update(buf.data(), (size_t)in.gcount());
+    }
+    return s.digest();
+}
+
+// ==================== Mapped File ====================
+
+MappedFile::MappedFile(const fs::path& path) {
+#ifdef _WIN32
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open: " + path.string());
+    file = h;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(h, &sz)) { close(); throw std::runtime_error("Cannot stat: " + path.string()); }
+    len = (size_t)sz.QuadPart;
+    if (len == 0) return;
+    mapping = CreateFileMappingW(h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) ptr = (const uint8_t*)MapViewOfFile((HANDLE)mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr) { close(); throw std::runtime_error("Cannot map: " + path.string()); }
+#else
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Cannot open: " + path.string());
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(); throw std::runtime_error("Cannot stat: " + path.string()); }
+    len = (size_t)st.st_size;
+    if (len == 0) return;
+    void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) { len = 0; close(); throw std::runtime_error("Cannot map: " + path.string()); }
+    ptr = (const uint8_t*)p;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (ptr) UnmapViewOfFile(ptr);
+    if (mapping) CloseHandle((HANDLE)mapping);
+    if (file) CloseHandle((HANDLE)file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (ptr) munmap((void*)ptr, len);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    ptr = nullptr;
+    len = 0;
+}
+
+// ==================== Hash Dictionary ====================
+
+void load_compiled_dictionary(HashDictionary& d, const fs::path& path) {
+    d.map = MappedFile(path);
+    dict_file_header h;
+    if (d.map.size() < sizeof(h)) throw std::runtime_error("Invalid compiled dictionary: " + path.string());
+    memcpy(&h, d.map.data(), sizeof(h));
+    if (memcmp(h.magic, "PCHD", 4) != 0)
+        throw std::runtime_error("Invalid compiled dictionary: " + path.string());
+    uint64_t need = sizeof(h) + (uint64_t)h.count * 8 + h.blob_size;
+    if (h.version != DICT_FILE_VERSION || need > d.map.size() || h.blob_size == 0)
+        throw std::runtime_error("Invalid compiled dictionary: " + path.string());
+    d.hashes  = (const uint32_t*)(d.map.data() + sizeof(h));
+    d.offsets = d.hashes + h.count;
+    d.blob    = (const char*)(d.offsets + h.count);
+    d.count   = h.count;
+    d.blob_size = h.blob_size;
+    if (d.blob[h.blob_size - 1] != '\0')
+        throw std::runtime_error("Invalid compiled dictionary: " + path.string());
+    
+    // find() relies on strictly increasing hashes and names inside the blob;
+    // only the two arrays are read, the names stay untouched
+    for (size_t i = 0; i < d.count; ++i) {
+        if (d.offsets[i] >= d.blob_size || (i > 0 && d.hashes[i] <= d.hashes[i - 1]))
+            throw std::runtime_error("Invalid compiled dictionary: " + path.string());
+    }
+}
+
+void load_text_dictionary(HashDictionary& d, const fs::path& path, const std::vector<uint32_t>* wanted) {
+    MappedFile text(path);
+    const char* p = (const char*)text.data();
+    const char* end = p + text.size();
+    
+    struct Entry { uint32_t hash, offset; };
+    std::vector<Entry> entries;
+    std::vector<char>& blob = d.own_blob;
+    auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; };
+    
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        const char* q = p;
+        p = eol + 1;
+        
+        while (q < eol && is_space(*q)) ++q;
+        if (eol - q < 3 || q[0] != '0' || (q[1] != 'x' && q[1] != 'X')) continue;
+        q += 2;
+        uint64_t v = 0;
+        int digits = 0;
+        for (; q < eol && isxdigit((unsigned char)*q); ++q, ++digits)
+            v = (v << 4) | (uint64_t)(isdigit((unsigned char)*q) ? *q - '0' : (tolower((unsigned char)*q) - 'a' + 10));
+        if (digits == 0) continue;
+        if (wanted && !std::binary_search(wanted->begin(), wanted->end(), (uint32_t)v)) continue;
+        while (q < eol && !is_space(*q)) ++q;   // rest of the hash token
+        while (q < eol && is_space(*q)) ++q;
+        const char* name = q;
+        q = eol;
+        while (q > name && is_space(q[-1])) --q;
+        if (q == name) continue;
+        
+        entries.push_back({(uint32_t)v, (uint32_t)blob.size()});
+        blob.insert(blob.end(), name, q);
+        blob.push_back('\0');
+    }
+    
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry& a, const Entry& b) { return a.hash < b.hash; });
+    d.own_hashes.clear();
+    d.own_offsets.clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i + 1 < entries.size() && entries[i + 1].hash == entries[i].hash) continue;
+        d.own_hashes.push_back(entries[i].hash);
+        d.own_offsets.push_back(entries[i].offset);
+    }
+    if (blob.empty()) blob.push_back('\0');
+    d.hashes  = d.own_hashes.data();
+    d.offsets = d.own_offsets.data();
+    d.blob    = blob.data();
+    d.count   = d.own_hashes.size();
+    d.blob_size = blob.size();
+}
+
+void load_dictionary(HashDictionary& d, const fs::path& path, const std::vector<uint32_t>* wanted) {
+    TraceScope trace("dict_load", path.string());
+    char magic[4] = {};
+    {
+        std::ifstream f(path, std::ios::binary);
+        if (!f) throw std::runtime_error("Cannot open: " + path.string());
+        f.read(magic, sizeof(magic));
+    }
+    d = HashDictionary();
+    if (memcmp(magic, "PCHD", 4) == 0)
+        load_compiled_dictionary(d, path);
+    else
+        load_text_dictionary(d, path, wanted);
+}
+
+void write_compiled_dictionary(const HashDictionary& d, const fs::path& path) {
+    dict_file_header h;
+    memcpy(h.magic, "PCHD", 4);
+    h.version = DICT_FILE_VERSION;
+    h.count = (uint32_t)d.count;
+    h.blob_size = (uint32_t)d.blob_size;
+    
+    std::ofstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("Cannot write: " + path.string());
+    f.write((const char*)&h, sizeof(h));
+    f.write((const char*)d.hashes, d.count * sizeof(uint32_t));
+    f.write((const char*)d.offsets, d.count * sizeof(uint32_t));
+    f.write(d.blob, h.blob_size);
+    if (!f) throw std::runtime_error("Write failed: " + path.string());
+}
+
+std::string resource_filename(const HashDictionary& d, uint32_t hash, uint32_t type) {
+    const char* name = d.find(hash);
+    char hex[16];
+    snprintf(hex, sizeof(hex), "0x%08X", hash);
+    std::string base = name ? std::string(name) : std::string(hex);
+    return base + get_ext(type);
+}
+
+std::unordered_map<std::string, uint32_t> name_hash_exceptions(const HashDictionary& d) {
+    std::vector<std::string_view> names(d.size());
+    for (size_t i = 0; i < names.size(); ++i) names[i] = d.blob + d.offsets[i];
+    std::vector<uint32_t> computed(names.size());
+    hash_strings(names.data(), names.size(), computed.data());
+    
+    std::unordered_map<std::string, uint32_t> exc;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (computed[i] == d.hashes[i]) continue;
+        // Another entry under the computed hash with this name wins
+        const char* other = d.find(computed[i]);
+        std::string lower = to_lower(std::string(names[i]));
+        if (other && to_lower(other) == lower) continue;
+        exc[lower] = d.hashes[i];
+    }
+    return exc;
+}
+
+// ==================== Resource Index ====================
+
+void ResourceIndex::build(const std::vector<resource_location>& locs, const resource_directory& dir) {
+    order.clear();
+    // type_end_idxs holds a count in the packs we write; accept an end index too
+    for (int as_count = 1; as_count >= 0; --as_count) {
+        for (int t = 0; t < NUM_TYPES; ++t) {
+            int64_t s = dir.type_start_idxs[t];
+            int64_t e = as_count ? s + dir.type_end_idxs[t] : dir.type_end_idxs[t];
+            bool empty = as_count ? dir.type_end_idxs[t] == 0 : e <= s;
+            start[t] = empty ? 0 : (uint32_t)std::max<int64_t>(s, 0);
+            end[t] = empty ? 0 : (uint32_t)std::max<int64_t>(e, 0);
+            if (!empty && (s < 0 || e > (int64_t)locs.size())) start[t] = end[t] = 0xFFFFFFFF;
+        }
+        if ((ranged = ranges_valid(locs))) return;
+    }
+    
+    order.resize(locs.size());
+    for (size_t i = 0; i < locs.size(); ++i) order[i] = (uint32_t)i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const auto& ka = locs[a].field_0;
+        const auto& kb = locs[b].field_0;
+        if (ka.m_type != kb.m_type) return ka.m_type < kb.m_type;
+        if (ka.m_hash.source_hash_code != kb.m_hash.source_hash_code)
+            return ka.m_hash.source_hash_code < kb.m_hash.source_hash_code;
+        return a < b;
+    });
+}
+
+bool ResourceIndex::ranges_valid(const std::vector<resource_location>& locs) const {
+    size_t covered = 0;
+    for (int t = 0; t < NUM_TYPES; ++t) {
+        if (start[t] > end[t] || end[t] > locs.size()) return false;
+        for (uint32_t i = start[t]; i < end[t]; ++i) {
+            if (locs[i].field_0.m_type != (uint32_t)t) return false;
+            if (i > start[t] && locs[i].field_0.m_hash.source_hash_code < locs[i - 1].field_0.m_hash.source_hash_code)
+                return false;
+        }
+        covered += end[t] - start[t];
+    }
+    return covered == locs.size();
+}
+
+int ResourceIndex::find(const std::vector<resource_location>& locs, uint32_t hash, uint32_t type) const {
+    if (ranged) {
+        if (type >= (uint32_t)NUM_TYPES) return -1;
+        auto first = locs.begin() + start[type];
+        auto last = locs.begin() + end[type];
+        auto it = std::upper_bound(first, last, hash, [](uint32_t h, const resource_location& rl) {
+            return h < rl.field_0.m_hash.source_hash_code;
+        });
+        if (it == first || (it - 1)->field_0.m_hash.source_hash_code != hash) return -1;
+        return (int)(it - 1 - locs.begin());
+    }
+    auto it = std::upper_bound(order.begin(), order.end(), std::make_pair(type, hash),
+        [&](const std::pair<uint32_t, uint32_t>& k, uint32_t i) {
+            const auto& key = locs[i].field_0;
+            if (k.first != key.m_type) return k.first < key.m_type;
+            return k.second < key.m_hash.source_hash_code;
+        });
+    if (it == order.begin()) return -1;
+    const auto& key = locs[*(it - 1)].field_0;
+    if (key.m_type != type || key.m_hash.source_hash_code != hash) return -1;
+    return (int)*(it - 1);
+}
+
+int ResourceIndex::find_first(const std::vector<resource_location>& locs, uint32_t hash, uint32_t type) const {
+    if (ranged) {
+        if (type >= (uint32_t)NUM_TYPES) return -1;
+        auto first = locs.begin() + start[type];
+        auto last = locs.begin() + end[type];
+        auto it = std::lower_bound(first, last, hash, [](const resource_location& rl, uint32_t h) {
+            return rl.field_0.m_hash.source_hash_code < h;
+        });
+        if (it == last || it->field_0.m_hash.source_hash_code != hash) return -1;
+        return (int)(it - locs.begin());
+    }
+    auto it = std::lower_bound(order.begin(), order.end(), std::make_pair(type, hash),
+        [&](uint32_t i, const std::pair<uint32_t, uint32_t>& k) {
+            const auto& key = locs[i].field_0;
+            if (key.m_type != k.first) return key.m_type < k.first;
+            return key.m_hash.source_hash_code < k.second;
+        });
+    if (it == order.end()) return -1;
+    const auto& key = locs[*it].field_0;
+    if (key.m_type != type || key.m_hash.source_hash_code != hash) return -1;
+    return (int)*it;
+}
+
+// ==================== Reader ====================
+
+ByteSpan ParsedPack::payload(size_t i) const {
+    const auto& rl = res_locs[i];
+    uint64_t start = (uint64_t)base() + rl.m_offset;
+    if (start + rl.m_size > raw.size())
+        throw std::runtime_error("Corrupted pack: resource out of bounds");
+    return { raw.data() + start, rl.m_size };
+}
+
+void parse_directory(ParsedPack& P, const uint8_t* data, size_t size) {
+    if (size < sizeof(resource_pack_header))
+        throw std::runtime_error("File too small for header");
+    
+    memcpy(&P.pack_header, data, sizeof(P.pack_header));
+    
+    uint32_t dir_off = P.pack_header.directory_offset;
+    if (dir_off + sizeof(generic_mash_header) + sizeof(resource_directory) > size)
+        throw std::runtime_error("Invalid directory offset");
+    
+    memcpy(&P.mash_header, &data[dir_off], sizeof(P.mash_header));
+    memcpy(&P.dir, &data[dir_off + sizeof(generic_mash_header)], sizeof(P.dir));
+    
+    // Parse vector data after directory
+    size_t pos = dir_off + sizeof(generic_mash_header) + sizeof(resource_directory);
+    
+    auto read_align = [&]() {
+        pos = align_up(pos, 8);
+        pos = align_up(pos, 4);
+    };
+    
+    auto read_i32_vec = [&](uint16_t count) -> std::vector<int32_t> {
+        read_align();
+        if (pos + count * sizeof(int32_t) > size)
+            throw std::runtime_error("Directory vector out of bounds");
+        std::vector<int32_t> v(count);
+        if (count > 0) {
+            memcpy(v.data(), &data[pos], count * sizeof(int32_t));
+            pos += count * sizeof(int32_t);
+        }
+        pos = align_up(pos, 4);
+        return v;
+    };
+    
+    auto read_res_locs = [&](uint16_t count) -> std::vector<resource_location> {
+        read_align();
+        P.res_locs_pos = pos;
+        if (pos + count * sizeof(resource_location) > size)
+            throw std::runtime_error("Directory vector out of bounds");
+        std::vector<resource_location> v(count);
+        if (count > 0) {
+            memcpy(v.data(), &data[pos], count * sizeof(resource_location));
+            pos += count * sizeof(resource_location);
+        }
+        pos = align_up(pos, 4);
+        return v;
+    };
+    
+    auto read_tl_locs = [&](uint16_t count) -> std::vector<tlresource_location> {
+        read_align();
+        if (pos + count * sizeof(tlresource_location) > size)
+            throw std::runtime_error("Directory vector out of bounds");
+        std::vector<tlresource_location> v(count);
+        if (count > 0) {
+            memcpy(v.data(), &data[pos], count * sizeof(tlresource_location));
+            pos += count * sizeof(tlresource_location);
+        }
+        pos = align_up(pos, 4);
+        return v;
+    };
+    
+    P.parents = read_i32_vec(P.dir.parents.m_size);
+    P.res_locs = read_res_locs(P.dir.resource_locations.m_size);
+    P.textures = read_tl_locs(P.dir.texture_locations.m_size);
+    P.mesh_files = read_tl_locs(P.dir.mesh_file_locations.m_size);
+    P.meshes = read_tl_locs(P.dir.mesh_locations.m_size);
+    P.morph_files = read_tl_locs(P.dir.morph_file_locations.m_size);
+    P.morphs = read_tl_locs(P.dir.morph_locations.m_size);
+    P.material_files = read_tl_locs(P.dir.material_file_locations.m_size);
+    P.materials = read_tl_locs(P.dir.material_locations.m_size);
+    P.anim_files = read_tl_locs(P.dir.anim_file_locations.m_size);
+    P.anims = read_tl_locs(P.dir.anim_locations.m_size);
+    P.scene_anims = read_tl_locs(P.dir.scene_anim_locations.m_size);
+    P.skeletons = read_tl_locs(P.dir.skeleton_locations.m_size);
+    
+    P.index.build(P.res_locs, P.dir);
+}
+
+ParsedPack parse_pcpack(const fs::path& path) {
+    TraceScope trace("parse", path.string());
+    ParsedPack P;
+    P.raw = MappedFile(path);
+    parse_directory(P, P.raw.data(), P.raw.size());
+    return P;
+}
+
+// Unbuffered positioned reads, so nothing past the requested bytes is fetched
+class PositionedFile {
+public:
+    explicit PositionedFile(const fs::path& path) : path(path) {
+#ifdef _WIN32
+        h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open: " + path.string());
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(h, &sz)) { CloseHandle(h); throw std::runtime_error("Cannot stat: " + path.string()); }
+        len = (uint64_t)sz.QuadPart;
+#else
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("Cannot open: " + path.string());
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); throw std::runtime_error("Cannot stat: " + path.string()); }
+        len = (uint64_t)st.st_size;
+#endif
+    }
+    ~PositionedFile() {
+#ifdef _WIN32
+        CloseHandle(h);
+#else
+        ::close(fd);
+#endif
+    }
+    PositionedFile(const PositionedFile&) = delete;
+    PositionedFile& operator=(const PositionedFile&) = delete;
+    
+    uint64_t size() const { return len; }
+    
+    // Exactly n bytes at off
+    void read(void* dst, size_t n, uint64_t off) {
+        uint8_t* p = (uint8_t*)dst;
+        while (n > 0) {
+#ifdef _WIN32
+            OVERLAPPED ov{};
+            ov.Offset = (DWORD)off;
+            ov.OffsetHigh = (DWORD)(off >> 32);
+            DWORD got = 0;
+            DWORD want = (DWORD)std::min<size_t>(n, 1u << 30);
+            if (!ReadFile(h, p, want, &got, &ov) || got == 0)
+                throw std::runtime_error("Read failed: " + path.string());
+#else
+            ssize_t got = pread(fd, p, std::min<size_t>(n, 1u << 30), (off_t)off);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) throw std::runtime_error("Read failed: " + path.string());
+#endif
+            p += got;
+            off += (uint64_t)got;
+            n -= (size_t)got;
+        }
+    }
+    
+private:
+    fs::path path;
+    uint64_t len = 0;
+#ifdef _WIN32
+    HANDLE h = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+};
+
+// End of the vectors that follow a directory at dir_off, laid out the way
+// parse_directory reads them
+static uint64_t directory_vectors_end(const resource_directory& dir, uint64_t dir_off) {
+    uint64_t pos = dir_off + sizeof(generic_mash_header) + sizeof(resource_directory);
+    auto skip = [&](uint64_t count, size_t elem) {
+        pos = align_up(align_up(pos, 8) + count * elem, 4);
+    };
+    skip(dir.parents.m_size, sizeof(int32_t));
+    skip(dir.resource_locations.m_size, sizeof(resource_location));
+    for (const auto* v : { &dir.texture_locations, &dir.mesh_file_locations, &dir.mesh_locations,
+                           &dir.morph_file_locations, &dir.morph_locations, &dir.material_file_locations,
+                           &dir.material_locations, &dir.anim_file_locations, &dir.anim_locations,
+                           &dir.scene_anim_locations, &dir.skeleton_locations })
+        skip(v->m_size, sizeof(tlresource_location));
+    return pos;
+}
+
+ParsedPack read_pack_directory(const fs::path& path) {
+    TraceScope trace("parse", path.string());
+    PositionedFile f(path);
+    
+    ParsedPack P;
+    if (f.size() < sizeof(P.pack_header))
+        throw std::runtime_error("File too small for header");
+    f.read(&P.pack_header, sizeof(P.pack_header), 0);
+    
+    uint64_t dir_off = P.pack_header.directory_offset;
+    uint64_t dir_end = dir_off + sizeof(generic_mash_header) + sizeof(resource_directory);
+    if (dir_end > f.size())
+        throw std::runtime_error("Invalid directory offset");
+    resource_directory dir;
+    f.read(&dir, sizeof(dir), dir_off + sizeof(generic_mash_header));
+    
+    // Only as far as the directory vectors reach, whatever the header claims
+    // as base: a corrupt res_dir_mash_size cannot pull in payload bytes
+    uint64_t want = directory_vectors_end(dir, dir_off);
+    if (want > f.size()) throw std::runtime_error("Directory vector out of bounds");
+    
+    std::vector<uint8_t> head((size_t)want);
+    memcpy(head.data(), &P.pack_header, sizeof(P.pack_header));
+    f.read(head.data() + sizeof(P.pack_header), (size_t)(want - sizeof(P.pack_header)), sizeof(P.pack_header));
+    
+    parse_directory(P, head.data(), head.size());
+    return P;
+}
+
+std::vector<uint32_t> pack_name_hashes(const ParsedPack& P) {
+    std::vector<uint32_t> v;
+    v.reserve(P.res_locs.size());
+    for (const auto& rl : P.res_locs) v.push_back(rl.field_0.m_hash.source_hash_code);
+    for (const auto* tl : { &P.textures, &P.mesh_files, &P.meshes, &P.morph_files, &P.morphs,
+                            &P.material_files, &P.materials, &P.anim_files, &P.anims,
+                            &P.scene_anims, &P.skeletons }) {
+        for (const auto& t : *tl) v.push_back(t.name.source_hash_code);
+    }
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    return v;
+}
+
+std::vector<tlresource_location>* tl_vector_for_type(ParsedPack& P, uint32_t type) {
+    switch (type) {
+    case 6:  // .DDS
+    case 7:  return &P.textures;         // .DDSMP
+    case 51: return &P.mesh_files;       // .PCMESHDEF
+    case 21: return &P.meshes;           // .PCMESH
+    case 52: return &P.morph_files;      // .PCMORPHDEF
+    case 22: return &P.morphs;           // .PCMORPH
+    case 53: return &P.material_files;   // .PCMATDEF
+    case 23: return &P.materials;        // .PCMAT
+    case 1:  return &P.anims;            // .PCANIM
+    case 26: return &P.scene_anims;      // .PCSANIM
+    case 2:  return &P.skeletons;        // .PCSKEL
+    default: return nullptr;
+    }
+}
+
+// Offsets outside every resource (0 or special values) are kept
+void update_tl_offsets(ParsedPack& P, const OffsetRemap& remap) {
+    TraceScope trace("tl_remap");
+    for_each_tl_vector(P, [&](const char*, std::vector<tlresource_location>& vec) {
+        for (auto& tl : vec) tl.offset = remap.map(tl.offset);
+    });
+}
+
+std::vector<uint8_t> serialize_directory(const ParsedPack& P) {
+    TraceScope trace("serialize_directory");
+    std::vector<uint8_t> out;
+    
+    // Write pack header
+    out.resize(sizeof(resource_pack_header));
+    memcpy(out.data(), &P.pack_header, sizeof(P.pack_header));
+    
+    // Pad to directory offset
+    if (out.size() < P.pack_header.directory_offset)
+        out.resize(P.pack_header.directory_offset, 0);
+    
+    // Write mash header
+    out.insert(out.end(), (const uint8_t*)&P.mash_header, (const uint8_t*)&P.mash_header + sizeof(P.mash_header));
+    
+    // Write directory
+    out.insert(out.end(), (const uint8_t*)&P.dir, (const uint8_t*)&P.dir + sizeof(P.dir));
+    
+    // Helper to write vectors with alignment
+    auto emit_align = [&](size_t a, uint8_t fill = 0xE3) {
+        size_t want = align_up(out.size(), a);
+        if (want > out.size()) out.insert(out.end(), want - out.size(), fill);
+    };
+    
+    auto emit_vec = [&](const auto& v) {
+        emit_align(8); emit_align(4);
+        if (!v.empty()) {
+            const uint8_t* p = (const uint8_t*)v.data();
+            out.insert(out.end(), p, p + v.size() * sizeof(v[0]));
+        }
+        emit_align(4);
+    };
+    
+    emit_vec(P.parents);
+    emit_vec(P.res_locs);
+    emit_vec(P.textures);
+    emit_vec(P.mesh_files);
+    emit_vec(P.meshes);
+    emit_vec(P.morph_files);
+    emit_vec(P.morphs);
+    emit_vec(P.material_files);
+    emit_vec(P.materials);
+    emit_vec(P.anim_files);
+    emit_vec(P.anims);
+    emit_vec(P.scene_anims);
+    emit_vec(P.skeletons);
+    
+    // Pad to base offset
+    if (out.size() < P.base()) {
+        out.resize(P.base(), 0xE3);
+    }
+    return out;
+}
+
+// ==================== Folder Names ====================
+
+ParsedName parse_folder_filename(const fs::path& p, const std::unordered_map<std::string, uint32_t>* exceptions,
+                                 const uint32_t* stem_hash) {
+    ParsedName r;
+    int t = type_from_ext(p.extension().string());
+    if (t < 0) return r;
+    
+    std::string stem = p.stem().string();
+    
+    // allow "0x12345678"
+    if (stem.size() >= 2 && stem[0] == '0' && (stem[1] == 'x' || stem[1] == 'X')) {
+        try {
+            r.hash = (uint32_t)std::stoul(stem, nullptr, 16);
+        } catch (...) {
+            return r;
+        }
+        r.type = (uint32_t)t;
+        r.ok = true;
+        return r;
+    }
+    
+    // any other name hashes like the game does, names in the dictionary or not
+    r.hash = stem_hash ? *stem_hash : hash_string(stem);
+    if (exceptions) {
+        auto it = exceptions->find(to_lower(stem));
+        if (it != exceptions->end()) r.hash = it->second;
+    }
+    r.type = (uint32_t)t;
+    r.ok = true;
+    return r;
+}
+
+// ==================== Payload Layout ====================
+
+const char* const layout_names[5] = { "original", "type-hash", "size", "binpack", "append" };
+
+PayloadLayout parse_layout(const std::string& name) {
+    for (size_t i = 0; i < sizeof(layout_names) / sizeof(layout_names[0]); ++i) {
+        if (name == layout_names[i]) return (PayloadLayout)i;
+    }
+    throw std::runtime_error("Unknown layout: " + name);
+}
+
+LayoutPlan plan_payload_layout(const std::vector<LayoutItem>& items, const std::vector<int>& shared_with,
+                               PayloadLayout layout, size_t align, size_t small_align) {
+    TraceScope trace("layout", layout_names[layout]);
+    if (small_align == 0 || small_align > align) small_align = align;
+    auto need = [&](size_t i) { return items[i].size < align ? small_align : align; };
+    
+    LayoutPlan plan;
+    plan.offsets.resize(items.size());
+    auto place = [&](size_t i, uint64_t at) {
+        if (at + items[i].size > UINT32_MAX)
+            throw std::runtime_error("Payload area too large for 32-bit offsets");
+        plan.padding += at - plan.end;
+        plan.offsets[i] = (uint32_t)at;
+        plan.end = at + items[i].size;
+    };
+    
+    std::vector<size_t> order;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (shared_with[i] < 0) order.push_back(i);
+    }
+    
+    if (layout == LAYOUT_BINPACK) {
+        // Fully aligned payloads keep index order; before each one, the gap up to
+        // its aligned start takes the largest small payloads that still fit
+        std::multimap<uint32_t, size_t> small;
+        std::vector<size_t> large;
+        for (size_t i : order) {
+            if (need(i) < align) small.emplace(items[i].size, i);
+            else large.push_back(i);
+        }
+        for (size_t i : large) {
+            uint64_t at = align_up(plan.end, align);
+            while (!small.empty()) {
+                uint64_t s = align_up(plan.end, small_align);
+                if (s >= at) break;
+                auto it = small.upper_bound((uint32_t)(at - s));
+                if (it == small.begin()) break;
+                --it;
+                place(it->second, s);
+                small.erase(it);
+            }
+            place(i, align_up(plan.end, align));
+        }
+        for (auto it = small.rbegin(); it != small.rend(); ++it)
+            place(it->second, align_up(plan.end, small_align));
+    } else {
+        if (layout == LAYOUT_TYPE_HASH) {
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                if (items[a].type != items[b].type) return items[a].type < items[b].type;
+                return items[a].hash < items[b].hash;
+            });
+        } else if (layout == LAYOUT_SIZE) {
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                if (need(a) != need(b)) return need(a) > need(b);
+                return items[a].size > items[b].size;
+            });
+        }
+        for (size_t i : order)
+            place(i, align_up(plan.end, need(i)));
+    }
+    
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (shared_with[i] >= 0) plan.offsets[i] = plan.offsets[shared_with[i]];
+    }
+    return plan;
+}
+
+// ==================== Payload Sources ====================
+
+PayloadSource kept_payload(const ParsedPack& P, size_t i) {
+    PayloadSource s;
+    s.bytes = P.payload(i);
+    s.size = s.bytes.size;
+    s.kept = true;
+    s.old_offset = P.res_locs[i].m_offset;
+    return s;
+}
+
+// Reads the bytes of one payload in order, from memory or its file
+struct PayloadReader {
+    const uint8_t* mem = nullptr;
+    std::ifstream file;
+    
+    explicit PayloadReader(const PayloadSource& s) {
+        if (s.bytes.data) mem = s.bytes.data;
+        else file.open(s.file, std::ios::binary);
+    }
+    
+    bool read(char* dst, size_t n) {
+        if (mem) { memcpy(dst, mem, n); mem += n; return true; }
+        file.read(dst, n);
+        return (size_t)file.gcount() == n;
+    }
+};
+
+static uint64_t payload_digest(const PayloadSource& s, std::vector<char>& buf) {
+    return s.bytes.data ? xxh64(s.bytes.data, s.bytes.size) : xxh64_file(s.file, buf);
+}
+
+SharedPayloads find_shared_payloads(const std::vector<PayloadSource>& payloads, bool dedupe) {
+    TraceScope trace("find_shared");
+    SharedPayloads sp;
+    sp.with.assign(payloads.size(), -1);
+    std::unordered_map<uint64_t, size_t> first_at;
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        const auto& p = payloads[i];
+        if (!p.kept || p.size == 0) continue;
+        auto ins = first_at.emplace(((uint64_t)p.old_offset << 32) | p.size, i);
+        if (!ins.second) sp.with[i] = (int)ins.first->second;
+    }
+    sp.aliases = std::count_if(sp.with.begin(), sp.with.end(), [](int s) { return s >= 0; });
+    if (!dedupe) return sp;
+    
+    // Same size and digest, then confirmed byte for byte
+    std::vector<char> a(1 << 16), b(1 << 16), buf(1 << 20);
+    std::unordered_map<uint64_t, size_t> by_digest;
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        const auto& p = payloads[i];
+        if (sp.with[i] >= 0 || p.size == 0) continue;
+        auto ins = by_digest.emplace(payload_digest(p, buf) ^ (p.size * Xxh64::P1), i);
+        if (ins.second) continue;
+        
+        size_t j = ins.first->second;
+        if (payloads[j].size != p.size) continue;
+        PayloadReader ra(p), rb(payloads[j]);
+        bool same = true;
+        for (uint64_t left = p.size; left > 0 && same; ) {
+            size_t n = (size_t)std::min<uint64_t>(left, a.size());
+            same = ra.read(a.data(), n) && rb.read(b.data(), n) && memcmp(a.data(), b.data(), n) == 0;
+            left -= n;
+        }
+        if (!same) continue;
+        sp.with[i] = (int)j;
+        sp.merged++;
+        sp.merged_bytes += p.size;
+    }
+    return sp;
+}
+
+// ==================== Writer ====================
+
+PackWriter::PackWriter(const fs::path& path, const MappedFile& source) : path(path), source(source) {
+#ifdef __linux__
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot write: " + path.string());
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_blksize > 0) block = (uint64_t)st.st_blksize;
+#else
+    of.open(path, std::ios::binary);
+    if (!of) throw std::runtime_error("Cannot write: " + path.string());
+#endif
+}
+
+PackWriter::~PackWriter() {
+#ifdef __linux__
+    if (fd >= 0) ::close(fd);
+#endif
+}
+
+void PackWriter::write(const void* data, size_t n) {
+    written += n;
+#ifdef __linux__
+    const uint8_t* p = (const uint8_t*)data;
+    while (n > 0) {
+        ssize_t r = pwrite(fd, p, n, (off_t)pos);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) throw std::runtime_error("Write failed: " + path.string());
+        p += r; n -= (size_t)r; pos += (uint64_t)r;
+        end = std::max(end, pos);
+    }
+#else
+    of.write((const char*)data, n);
+    pos += n;
+#endif
+}
+
+void PackWriter::pad_to(uint64_t target) {
+#ifdef __linux__
+    pos = target;
+#else
+    static const char zeros[4096] = {};
+    while (pos < target) write(zeros, (size_t)std::min<uint64_t>(target - pos, sizeof(zeros)));
+#endif
+}
+
+void PackWriter::copy_source(uint64_t src_off, uint64_t n) {
+#ifdef __linux__
+    if (can_clone && n >= block && src_off % block == pos % block) {
+        uint64_t head = std::min(n, (block - src_off % block) % block);
+        copy_range(source.descriptor(), src_off, head);
+        uint64_t mid = (n - head) / block * block;
+        if (mid > 0 && clone_range(src_off + head, mid)) {
+            src_off += head + mid;
+            n -= head + mid;
+        } else {
+            src_off += head;
+            n -= head;
+        }
+    }
+    copy_range(source.descriptor(), src_off, n);
+#else
+    write(source.data() + src_off, (size_t)n);
+#endif
+}
+
+void PackWriter::copy_file(const fs::path& file, uint64_t n, std::vector<char>& buf) {
+#ifdef __linux__
+    int in = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) throw std::runtime_error("Cannot open: " + file.string());
+    uint64_t off = 0;
+    try {
+        if (can_copy) off = kernel_copy(in, 0, n);
+        for (; off < n; ) {
+            ssize_t r = pread(in, buf.data(), (size_t)std::min<uint64_t>(n - off, buf.size()), (off_t)off);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) throw std::runtime_error("File changed while importing: " + file.string());
+            write(buf.data(), (size_t)r);
+            off += (uint64_t)r;
+        }
+    } catch (...) {
+        ::close(in);
+        throw;
+    }
+    ::close(in);
+#else
+    std::ifstream in(file, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open: " + file.string());
+    while (n > 0) {
+        size_t k = (size_t)std::min<uint64_t>(n, buf.size());
+        in.read(buf.data(), k);
+        if ((size_t)in.gcount() != k)
+            throw std::runtime_error("File changed while importing: " + file.string());
+        write(buf.data(), k);
+        n -= k;
+    }
+#endif
+}
+
+void PackWriter::close() {
+#ifdef __linux__
+    if (end < pos && ftruncate(fd, (off_t)pos) != 0)
+        throw std::runtime_error("Write failed: " + path.string());
+    end = pos;
+    int r = ::close(fd);
+    fd = -1;
+    if (r != 0) throw std::runtime_error("Write failed: " + path.string());
+#else
+    of.close();
+    if (!of) throw std::runtime_error("Write failed: " + path.string());
+#endif
+}
+
+#ifdef __linux__
+// copy_file_range from in at off; returns how much it copied before the
+// kernel refused (the rest is up to the caller)
+uint64_t PackWriter::kernel_copy(int in, uint64_t off, uint64_t n) {
+    uint64_t done = 0;
+    while (done < n) {
+        loff_t in_off = (loff_t)(off + done), out_off = (loff_t)pos;
+        ssize_t r = copy_file_range(in, &in_off, fd, &out_off, (size_t)std::min<uint64_t>(n - done, 1u << 30), 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            if (r < 0 && errno != EXDEV && errno != EINVAL && errno != ENOSYS && errno != EOPNOTSUPP)
+                throw std::runtime_error("Write failed: " + path.string());
+            // 0 is a short source, left to the caller to report; other
+            // refusals may be for this file only (another filesystem)
+            if (r < 0 && (errno == ENOSYS || errno == EOPNOTSUPP)) can_copy = false;
+            break;
+        }
+        done += (uint64_t)r;
+        pos += (uint64_t)r;
+        end = std::max(end, pos);
+        kernel_copied += (uint64_t)r;
+    }
+    return done;
+}
+
+void PackWriter::copy_range(int in, uint64_t off, uint64_t n) {
+    uint64_t done = can_copy ? kernel_copy(in, off, n) : 0;
+    if (done < n) write(source.data() + off + done, (size_t)(n - done));
+}
+
+bool PackWriter::clone_range(uint64_t src_off, uint64_t n) {
+    // The destination may start past the end of what was written so far
+    if (end < pos) {
+        if (ftruncate(fd, (off_t)pos) != 0) throw std::runtime_error("Write failed: " + path.string());
+        end = pos;
+    }
+    file_clone_range r{};
+    r.src_fd = source.descriptor();
+    r.src_offset = src_off;
+    r.src_length = n;
+    r.dest_offset = pos;
+    if (ioctl(fd, FICLONERANGE, &r) != 0) {
+        can_clone = false;
+        return false;
+    }
+    pos += n;
+    end = pos;
+    cloned += n;
+    return true;
+}
+#endif
+
+WriteStats write_pack(const fs::path& path, const ParsedPack& P, const std::vector<PayloadSource>& payloads,
+                      const std::vector<int>& shared_with) {
+    if (payloads.size() != P.res_locs.size() || shared_with.size() != P.res_locs.size())
+        throw std::runtime_error("Payload list does not match the directory");
+    TraceScope trace("write_pack", path.string());
+    
+    WriteStats st;
+    std::vector<uint8_t> head = serialize_directory(P);
+    st.directory = head.size();
+    
+    PackWriter of(path, P.raw);
+    of.write(head.data(), head.size());
+    
+    // Payloads in offset order; shared ones were stored with their first entry.
+    // Empty payloads have nothing to write and may sit at the start of (or
+    // inside) another one, so they only keep the file long enough to reach them.
+    std::vector<size_t> order;
+    uint64_t empty_end = 0;
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        if (shared_with[i] >= 0) continue;
+        if (P.res_locs[i].m_size > 0) order.push_back(i);
+        else empty_end = std::max<uint64_t>(empty_end, (uint64_t)P.base() + P.res_locs[i].m_offset);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return P.res_locs[a].m_offset < P.res_locs[b].m_offset;
+    });
+    
+    std::vector<char> buf(1 << 20);
+    {
+        TraceScope trace_payloads("write_payloads");
+        for (size_t i : order) {
+            const PayloadSource& src = payloads[i];
+            uint64_t start = (uint64_t)P.base() + P.res_locs[i].m_offset;
+            uint64_t size = P.res_locs[i].m_size;
+            if (of.position() > start)
+                throw std::runtime_error("Overlapping payload layout");
+            of.pad_to(start);
+            
+            if (src.bytes.data && P.raw.contains(src.bytes.data))
+                of.copy_source((uint64_t)(src.bytes.data - P.raw.data()), size);
+            else if (src.bytes.data)
+                of.write(src.bytes.data, (size_t)size);
+            else
+                of.copy_file(src.file, size, buf);
+        }
+        if (of.position() < empty_end) of.pad_to(empty_end);
+    }
+    
+    st.size = of.position();
+    {
+        TraceScope trace_close("close");
+        of.close();
+    }
+    st.cloned = of.cloned;
+    st.kernel_copied = of.kernel_copied;
+    st.written = of.written;
+    return st;
+}
+
+// ==================== Reimport ====================
+
+ReimportResult plan_reimport(ParsedPack& P, const fs::path& folder,
+                             const std::unordered_map<std::string, uint32_t>& exceptions,
+                             const LayoutOptions& layout, bool dedupe) {
+    TraceScope trace("plan_reimport", folder.string());
+    if (!fs::is_directory(folder))
+        throw std::runtime_error("Reimport folder does not exist or is not a directory: " + folder.string());
+    if (layout.layout == LAYOUT_APPEND)
+        throw std::runtime_error("Reimport sorts every resource, the append layout does not apply");
+    
+    struct Item {
+        uint32_t hash = 0;
+        uint32_t type = 0;
+        PayloadSource src;
+        bool has_old = false;
+        uint32_t old_offset = 0;
+        uint32_t old_size = 0;
+    };
+    
+    ReimportResult r;
+    const size_t old_count = P.res_locs.size();
+    std::vector<Item> items(old_count);
+    for (size_t i = 0; i < old_count; ++i) {
+        const auto& rl = P.res_locs[i];
+        items[i].hash = rl.field_0.m_hash.source_hash_code;
+        items[i].type = rl.field_0.m_type;
+        items[i].src = kept_payload(P, i);
+        items[i].has_old = true;
+        items[i].old_offset = rl.m_offset;
+        items[i].old_size = rl.m_size;
+    }
+    
+    // Hash every file name in one pass; new resources need no dictionary entry
+    // The export manifest would otherwise come back as a .TXT resource
+    std::vector<fs::path> files;
+    for (auto& de : fs::directory_iterator(folder)) {
+        if (!de.is_regular_file()) continue;
+        if (de.path().filename() == "_manifest.txt") continue;
+        files.push_back(de.path());
+    }
+    std::sort(files.begin(), files.end());
+    std::vector<std::string> stems(files.size());
+    std::vector<std::string_view> stem_views(files.size());
+    for (size_t f = 0; f < files.size(); ++f) {
+        stems[f] = files[f].stem().string();
+        stem_views[f] = stems[f];
+    }
+    std::vector<uint32_t> stem_hashes(files.size());
+    hash_strings(stem_views.data(), stem_views.size(), stem_hashes.data());
+    
+    // Existing resources are found through P.index; only new files need a map
+    std::unordered_map<uint64_t, size_t> added_index;
+    std::vector<char> buf(1 << 20);
+    for (size_t f = 0; f < files.size(); ++f) {
+        const fs::path& path = files[f];
+        ParsedName pn = parse_folder_filename(path, &exceptions, &stem_hashes[f]);
+        std::error_code ec;
+        uint64_t size = pn.ok ? fs::file_size(path, ec) : 0;
+        if (!pn.ok || ec || size > UINT32_MAX) { r.skipped++; continue; }
+        
+        uint64_t key = ((uint64_t)pn.type << 32) | pn.hash;
+        int found = P.find(pn.hash, pn.type);
+        size_t idx = found >= 0 ? (size_t)found : SIZE_MAX;
+        if (found < 0) {
+            auto it = added_index.find(key);
+            if (it != added_index.end()) idx = it->second;
+        }
+        
+        // Files straight from an export keep the original bytes
+        if (idx < old_count && size == P.res_locs[idx].m_size &&
+            xxh64_file(path, buf) == payload_digest(kept_payload(P, idx), buf)) {
+            r.unchanged++;
+            continue;
+        }
+        
+        PayloadSource src;
+        src.file = path;
+        src.size = size;
+        if (idx != SIZE_MAX) {
+            items[idx].src = src;
+            r.updated++;
+        } else {
+            Item ni;
+            ni.hash = pn.hash;
+            ni.type = pn.type;
+            ni.src = src;
+            added_index[key] = items.size();
+            items.push_back(ni);
+            r.added++;
+        }
+    }
+    
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        if (a.type != b.type) return a.type < b.type;
+        return a.hash < b.hash;
+    });
+    if (items.size() > UINT16_MAX)
+        throw std::runtime_error("Too many resources for one pack");
+    
+    // resource_locations and the type runs (type_end_idxs holds a count)
+    P.res_locs.assign(items.size(), resource_location{});
+    r.payloads.resize(items.size());
+    for (int t = 0; t < NUM_RESOURCE_TYPES; ++t) {
+        P.dir.type_start_idxs[t] = 0;
+        P.dir.type_end_idxs[t] = 0;
+    }
+    for (size_t i = 0; i < items.size(); ++i) {
+        auto& rl = P.res_locs[i];
+        rl.field_0.m_hash.source_hash_code = items[i].hash;
+        rl.field_0.m_type = items[i].type;
+        rl.m_size = (uint32_t)items[i].src.size;
+        r.payloads[i] = items[i].src;
+        
+        uint32_t t = items[i].type;
+        if (t >= (uint32_t)NUM_RESOURCE_TYPES) continue;
+        if (P.dir.type_end_idxs[t] == 0) P.dir.type_start_idxs[t] = (int32_t)i;
+        P.dir.type_end_idxs[t] += 1;
+    }
+    P.dir.resource_locations.m_size = (uint16_t)P.res_locs.size();
+    
+    r.shared = find_shared_payloads(r.payloads, dedupe);
+    std::vector<LayoutItem> lay(items.size());
+    for (size_t i = 0; i < items.size(); ++i)
+        lay[i] = { P.res_locs[i].m_size, items[i].type, items[i].hash };
+    LayoutPlan plan = plan_payload_layout(lay, r.shared.with, layout.layout, layout.align, layout.small_align);
+    r.padding = plan.padding;
+    r.original_padding = plan_payload_layout(lay, r.shared.with, LAYOUT_ORIGINAL, layout.align, layout.align).padding;
+    for (size_t i = 0; i < items.size(); ++i) P.res_locs[i].m_offset = plan.offsets[i];
+    P.index.build(P.res_locs, P.dir);
+    
+    // Existing TL entries follow their payload; items[i] became res_locs[i], so
+    // the new offset of every old range is known directly. This runs before
+    // new entries are added, which already hold new offsets.
+    OffsetRemap remap;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].has_old) remap.add(items[i].old_offset, items[i].old_size, P.res_locs[i].m_offset);
+    }
+    remap.finish();
+    update_tl_offsets(P, remap);
+    
+    // New resources of a type with a TL vector get an entry there.
+    // tlresource_location.type is the resource type truncated to 8 bits.
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].has_old) continue;
+        auto* vec = tl_vector_for_type(P, items[i].type);
+        if (!vec) continue;
+        uint8_t t8 = (uint8_t)items[i].type;
+        bool listed = std::any_of(vec->begin(), vec->end(), [&](const tlresource_location& tl) {
+            return tl.name.source_hash_code == items[i].hash && tl.type == t8;
+        });
+        if (listed) continue;
+        tlresource_location tl{};
+        tl.name.source_hash_code = items[i].hash;
+        tl.type = t8;
+        tl.offset = P.res_locs[i].m_offset;
+        vec->push_back(tl);
+    }
+    
+    auto sort_tl = [](std::vector<tlresource_location>& v) {
+        std::sort(v.begin(), v.end(), [](const tlresource_location& a, const tlresource_location& b) {
+            if (a.type != b.type) return a.type < b.type;
+            return a.name.source_hash_code < b.name.source_hash_code;
+        });
+    };
+    for_each_tl_vector(P, [&](const char*, std::vector<tlresource_location>& v) { sort_tl(v); });
+    P.dir.texture_locations.m_size = (uint16_t)P.textures.size();
+    P.dir.mesh_file_locations.m_size = (uint16_t)P.mesh_files.size();
+    P.dir.mesh_locations.m_size = (uint16_t)P.meshes.size();
+    P.dir.morph_file_locations.m_size = (uint16_t)P.morph_files.size();
+    P.dir.morph_locations.m_size = (uint16_t)P.morphs.size();
+    P.dir.material_file_locations.m_size = (uint16_t)P.material_files.size();
+    P.dir.material_locations.m_size = (uint16_t)P.materials.size();
+    P.dir.anim_file_locations.m_size = (uint16_t)P.anim_files.size();
+    P.dir.anim_locations.m_size = (uint16_t)P.anims.size();
+    P.dir.scene_anim_locations.m_size = (uint16_t)P.scene_anims.size();
+    P.dir.skeleton_locations.m_size = (uint16_t)P.skeletons.size();
+    
+    // The directory may have grown or shrunk: payloads start at the next
+    // 16 byte boundary after it, in the header and the directory alike
+    if (P.pack_header.directory_offset < sizeof(resource_pack_header))
+        P.pack_header.directory_offset = (uint32_t)sizeof(resource_pack_header);
+    P.pack_header.res_dir_mash_size = 0;
+    uint32_t new_base = (uint32_t)align_up(serialize_directory(P).size(), 16);
+    P.pack_header.res_dir_mash_size = new_base;
+    P.dir.base = (int32_t)new_base;
+    return r;
+}
+
+} // namespace pcpack
@@ -0,0 +1,691 @@
+// pcpack.h - Ultimate Spider-Man PCPACK core library
+// Everything the command line tool and the GUI share: the on-disk structures,
+// name hashing and dictionaries, a zero-copy reader over a mapped pack, the
+// payload layout planner, folder reimport and a streaming writer. No output;
+// the only global state is the opt-in phase trace. Errors are
+// std::runtime_error.
+//
+// Build (Linux):
+//   cmake -S . -B build && cmake --build build
+// or compile libpcpack/pcpack.cpp together with a front end.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+
+namespace pcpack {
+
+namespace fs = std::filesystem;
+
+// ==================== Structures ====================
+
+#pragma pack(push, 1)
+
+struct resource_versions {
+    uint32_t field_0, field_4, field_8, field_C, field_10;
+};
+static_assert(sizeof(resource_versions) == 0x14, "");
+
+struct resource_pack_header {
+    resource_versions field_0;      // 0x00-0x13
+    uint32_t          field_14;     // 0x14
+    uint32_t          directory_offset;  // 0x18 - typically 0x30
+    uint32_t          res_dir_mash_size; // 0x1C - base offset where payloads start (0x1020)
+    uint32_t          field_20;     // 0x20
+    uint32_t          field_24;     // 0x24
+    uint32_t          field_28;     // 0x28
+};
+static_assert(sizeof(resource_pack_header) == 0x2C, "");
+
+struct generic_mash_header {
+    int32_t safety_key;   // 0x00
+    int32_t field_4;      // 0x04
+    int32_t field_8;      // 0x08 - total size of mash data
+    int16_t class_id;     // 0x0C
+    int16_t field_E;      // 0x0E
+};
+static_assert(sizeof(generic_mash_header) == 0x10, "");
+
+struct string_hash {
+    uint32_t source_hash_code;
+};
+
+struct resource_key {
+    string_hash m_hash;
+    uint32_t    m_type;
+};
+
+struct resource_location {
+    resource_key field_0;
+    uint32_t     m_offset;  // relative to base (res_dir_mash_size)
+    uint32_t     m_size;
+};
+static_assert(sizeof(resource_location) == 0x10, "");
+
+template<typename T>
+struct mashable_vector_t {
+    uint32_t m_data;    // on-disk pointer placeholder
+    uint16_t m_size;    // element count
+    uint8_t  m_shared;
+    uint8_t  field_7;
+};
+static_assert(sizeof(mashable_vector_t<uint32_t>) == 8, "");
+
+struct tlresource_location {
+    string_hash name;
+    uint8_t     type;
+    uint8_t     pad[3];
+    uint32_t    offset;  // relative to base
+};
+static_assert(sizeof(tlresource_location) == 0x0C, "");
+
+struct resource_directory {
+    mashable_vector_t<int32_t>             parents;               // 0x00
+    mashable_vector_t<resource_location>   resource_locations;    // 0x08
+    mashable_vector_t<tlresource_location> texture_locations;     // 0x10
+    mashable_vector_t<tlresource_location> mesh_file_locations;   // 0x18
+    mashable_vector_t<tlresource_location> mesh_locations;        // 0x20
+    mashable_vector_t<tlresource_location> morph_file_locations;  // 0x28
+    mashable_vector_t<tlresource_location> morph_locations;       // 0x30
+    mashable_vector_t<tlresource_location> material_file_locations; // 0x38
+    mashable_vector_t<tlresource_location> material_locations;    // 0x40
+    mashable_vector_t<tlresource_location> anim_file_locations;   // 0x48
+    mashable_vector_t<tlresource_location> anim_locations;        // 0x50
+    mashable_vector_t<tlresource_location> scene_anim_locations;  // 0x58
+    mashable_vector_t<tlresource_location> skeleton_locations;    // 0x60
+    mashable_vector_t<int32_t>             field_68;              // 0x68
+    mashable_vector_t<int32_t>             field_70;              // 0x70
+    int32_t pack_slot;     // 0x78
+    int32_t base;          // 0x7C - same as res_dir_mash_size
+    int32_t field_80;      // 0x80
+    int32_t field_84;      // 0x84
+    int32_t field_88;      // 0x88
+    int32_t type_start_idxs[70]; // 0x8C
+    int32_t type_end_idxs[70];   // 0x1A4
+};
+static_assert(sizeof(resource_directory) == 0x2BC, "");
+
+#pragma pack(pop)
+
+// ==================== Type Extension Table ====================
+
+static const int NUM_RESOURCE_TYPES = 70;
+extern const char* const resource_type_ext[NUM_RESOURCE_TYPES];
+
+// Extension of a resource type, ".UNK" past the table
+const char* get_ext(uint32_t type);
+
+// Resource type of an extension (case-insensitive), or -1
+int type_from_ext(const std::string& ext);
+
+// ==================== Helpers ====================
+
+size_t align_up(size_t x, size_t a);
+std::string sanitize_filename(const std::string& name);
+
+// Bytes owned by someone else, usually a payload inside a mapped pack
+struct ByteSpan {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    
+    bool empty() const { return size == 0; }
+    const uint8_t* begin() const { return data; }
+    const uint8_t* end() const { return data + size; }
+};
+
+// ==================== Trace ====================
+
+// Opt-in timing of pipeline phases. Until trace_start() a TraceScope does
+// nothing but check a flag; after it every scope records one event with the
+// thread it ran on, which write_trace saves in Chrome trace-event format
+// (chrome://tracing, ui.perfetto.dev).
+struct TraceEvent {
+    const char* name;
+    std::string detail;   // file or other argument, may be empty
+    int64_t     start_us; // since trace_start
+    int64_t     dur_us;
+    uint32_t    tid;      // 1 is the thread that called trace_start
+};
+
+void trace_start();
+bool trace_enabled();
+
+// Events recorded so far, by start time
+std::vector<TraceEvent> trace_events();
+
+void write_trace(const fs::path& path);
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, std::string_view detail = {});
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    
+private:
+    const char* name = nullptr;
+    std::string detail;
+    int64_t start_us = -1;
+};
+
+// ==================== Name Hash ====================
+
+// The game's string_hash of a resource name: h = h * 33 + tolower(c)
+uint32_t hash_string(std::string_view name);
+
+// hash_string of many names at once. Names go in groups of HASH_LANES and
+// every step adds one character to each lane, so the multiply-adds of a group
+// are independent and run side by side in vector registers instead of one
+// long dependency chain per name.
+static const size_t HASH_LANES = 8;
+void hash_strings(const std::string_view* names, size_t count, uint32_t* out);
+
+// ==================== Content Hash ====================
+// XXH64 (xxHash, 64-bit variant). Used to tell unchanged files apart from real
+// replacements without comparing them byte by byte against the pack.
+
+struct Xxh64 {
+    static constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+    
+    uint64_t v[4] = { P1 + P2, P2, 0, 0 - P1 };
+    uint64_t total = 0;
+    uint8_t  tail[32];
+    size_t   tail_len = 0;
+    
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static uint64_t read64(const uint8_t* p) { uint64_t x; memcpy(&x, p, 8); return x; }
+    static uint32_t read32(const uint8_t* p) { uint32_t x; memcpy(&x, p, 4); return x; }
+    static uint64_t round(uint64_t acc, uint64_t in) { return rotl(acc + in * P2, 31) * P1; }
+    static uint64_t merge(uint64_t h, uint64_t acc) { return (h ^ round(0, acc)) * P1 + P4; }
+    
+    void stripe(const uint8_t* p) {
+        for (int i = 0; i < 4; ++i) v[i] = round(v[i], read64(p + i * 8));
+    }
+    
+    void update(const void* data, size_t len) {
+        const uint8_t* p = (const uint8_t*)data;
+        total += len;
+        if (tail_len) {
+            size_t n = std::min(len, 32 - tail_len);
+            memcpy(tail + tail_len, p, n);
+            tail_len += n; p += n; len -= n;
+            if (tail_len < 32) return;
+            stripe(tail);
+            tail_len = 0;
+        }
+        for (; len >= 32; p += 32, len -= 32) stripe(p);
+        memcpy(tail, p, len);
+        tail_len = len;
+    }
+    
+    uint64_t digest() const {
+        uint64_t h;
+        if (total >= 32) {
+            h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+            for (int i = 0; i < 4; ++i) h = merge(h, v[i]);
+        } else {
+            h = v[2] + P5;
+        }
+        h += total;
+        const uint8_t* p = tail;
+        size_t len = tail_len;
+        for (; len >= 8; p += 8, len -= 8) h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+        if (len >= 4) { h = rotl(h ^ (read32(p) * P1), 23) * P2 + P3; p += 4; len -= 4; }
+        for (; len > 0; ++p, --len) h = rotl(h ^ (*p * P5), 11) * P1;
+        h ^= h >> 33; h *= P2;
+        h ^= h >> 29; h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+};
+
+uint64_t xxh64(const void* data, size_t len);
+
+// Digest of a whole file, read through buf
+uint64_t xxh64_file(const fs::path& path, std::vector<char>& buf);
+
+// ==================== Mapped File ====================
+
+// Read-only mapping of a whole file. Payloads are exported straight from the
+// mapped pages, so opening a pack costs the same whatever its size.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const fs::path& path);
+    ~MappedFile() { close(); }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& o) noexcept { swap(o); }
+    MappedFile& operator=(MappedFile&& o) noexcept { if (this != &o) { close(); swap(o); } return *this; }
+    
+    const uint8_t* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    const uint8_t& operator[](size_t i) const { return ptr[i]; }
+    bool contains(const uint8_t* p) const { return p >= ptr && p < ptr + len; }
+#ifndef _WIN32
+    int descriptor() const { return fd; }
+#endif
+    
+private:
+    void swap(MappedFile& o) noexcept {
+        std::swap(ptr, o.ptr);
+        std::swap(len, o.len);
+        std::swap(file, o.file);
+        std::swap(mapping, o.mapping);
+        std::swap(fd, o.fd);
+    }
+    void close();
+    
+    const uint8_t* ptr = nullptr;
+    size_t len = 0;
+    void* file = nullptr;      // Windows file and mapping handles
+    void* mapping = nullptr;
+    int fd = -1;
+};
+
+// ==================== Hash Dictionary ====================
+
+// On-disk layout written by `dict compile`, followed by
+//   uint32_t hashes[count]   sorted ascending
+//   uint32_t offsets[count]  name offset into the blob
+//   char     blob[blob_size] NUL-terminated names
+struct dict_file_header {
+    char     magic[4];   // "PCHD"
+    uint32_t version;
+    uint32_t count;
+    uint32_t blob_size;
+};
+static_assert(sizeof(dict_file_header) == 0x10, "");
+
+static const uint32_t DICT_FILE_VERSION = 1;
+
+// hash -> name table as three flat arrays, searched with a binary search.
+// A compiled dictionary is used straight from its mapping; a text dictionary
+// is parsed into owned arrays of the same shape.
+struct HashDictionary {
+    MappedFile map;
+    std::vector<uint32_t> own_hashes;
+    std::vector<uint32_t> own_offsets;
+    std::vector<char>     own_blob;
+    
+    const uint32_t* hashes = nullptr;
+    const uint32_t* offsets = nullptr;
+    const char*     blob = nullptr;
+    size_t          count = 0;
+    size_t          blob_size = 0;
+    
+    size_t size() const { return count; }
+    
+    const char* find(uint32_t hash) const {
+        const uint32_t* it = std::lower_bound(hashes, hashes + count, hash);
+        if (it == hashes + count || *it != hash) return nullptr;
+        return blob + offsets[it - hashes];
+    }
+};
+
+void load_compiled_dictionary(HashDictionary& d, const fs::path& path);
+
+// Lines look like "0x00000ce4<TAB>AC"; the name is the rest of the line, which
+// may contain spaces ("BIP01 NECK1"). Anything that does not start with a
+// hex hash is skipped; for repeated hashes the last line wins. When `wanted`
+// is given (sorted), only those hashes are kept, so the table holds the few
+// names a pack needs rather than the whole dictionary.
+void load_text_dictionary(HashDictionary& d, const fs::path& path, const std::vector<uint32_t>* wanted = nullptr);
+
+// Either format, told apart by the "PCHD" magic. `wanted` only filters a text
+// dictionary; a compiled one is mapped as a whole and untouched pages are
+// never read.
+void load_dictionary(HashDictionary& d, const fs::path& path, const std::vector<uint32_t>* wanted = nullptr);
+
+// Writes d in the format load_compiled_dictionary maps
+void write_compiled_dictionary(const HashDictionary& d, const fs::path& path);
+
+// Dictionary name of a resource, or 0xHASH when unknown, plus its extension
+std::string resource_filename(const HashDictionary& d, uint32_t hash, uint32_t type);
+
+// Names map back to hashes through hash_string; only the few dictionary
+// entries whose stored hash is not the hash of their name need a table,
+// keyed by the lower-case name.
+std::unordered_map<std::string, uint32_t> name_hash_exceptions(const HashDictionary& d);
+
+// ==================== Offset Remap ====================
+
+// Maps an offset inside an old payload range to the same position in the new
+// layout. Ranges are sorted once, so every tlresource_location costs a binary
+// search instead of a scan over all resource_locations. Where ranges overlap
+// (aliased entries, or a payload containing later ones) the first one added
+// wins, as it did with the linear scan.
+struct OffsetRemap {
+    struct Range {
+        uint32_t old_start;
+        uint32_t old_end;
+        uint32_t new_start;
+        uint32_t seq;   // order of add()
+    };
+    std::vector<Range> ranges;
+    std::vector<uint32_t> reach;   // reach[i]: largest old_end of ranges[0..i]
+    
+    void add(uint32_t old_start, uint32_t size, uint32_t new_start) {
+        if (size > 0) ranges.push_back({old_start, old_start + size, new_start, (uint32_t)ranges.size()});
+    }
+    
+    void finish() {
+        std::stable_sort(ranges.begin(), ranges.end(),
+                         [](const Range& a, const Range& b) { return a.old_start < b.old_start; });
+        reach.resize(ranges.size());
+        uint32_t end = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) reach[i] = end = std::max(end, ranges[i].old_end);
+    }
+    
+    // Returns old_off unchanged when it is not inside any old payload. Walks
+    // back from the last range starting at or before old_off for as long as
+    // an earlier range still reaches past it; without overlaps that is one step.
+    uint32_t map(uint32_t old_off) const {
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), old_off,
+                                   [](uint32_t off, const Range& r) { return off < r.old_start; });
+        const Range* best = nullptr;
+        for (size_t j = (size_t)(it - ranges.begin()); j > 0 && reach[j - 1] > old_off; --j) {
+            const Range& r = ranges[j - 1];
+            if (old_off < r.old_end && (!best || r.seq < best->seq)) best = &r;
+        }
+        return best ? best->new_start + (old_off - best->old_start) : old_off;
+    }
+};
+
+// ==================== Resource Index ====================
+// (hash, type) -> resource index. The game keeps res_locs sorted by type then
+// hash and describes each type's run with type_start_idxs/type_end_idxs, so
+// lookups are a binary search inside one run and need no memory. Packs that do
+// not follow that layout get a sorted index built once instead.
+//
+// With duplicate keys find returns the last entry, as in export where a later
+// entry overwrites the file of an earlier one; find_first returns the first.
+
+struct ResourceIndex {
+    static const int NUM_TYPES = NUM_RESOURCE_TYPES;
+    
+    bool ranged = false;
+    uint32_t start[NUM_TYPES] = {};
+    uint32_t end[NUM_TYPES] = {};     // exclusive
+    std::vector<uint32_t> order;      // fallback: indices sorted by type, hash, index
+    
+    void build(const std::vector<resource_location>& locs, const resource_directory& dir);
+    
+    // Every entry sits in the run of its type and every run is sorted by hash
+    bool ranges_valid(const std::vector<resource_location>& locs) const;
+    
+    // Index of the entry with this key, or -1
+    int find(const std::vector<resource_location>& locs, uint32_t hash, uint32_t type) const;
+    int find_first(const std::vector<resource_location>& locs, uint32_t hash, uint32_t type) const;
+    
+    // Calls fn(index) for every entry of one type
+    template<typename Fn>
+    void for_each_of_type(const std::vector<resource_location>& locs, uint32_t type, Fn fn) const {
+        if (ranged) {
+            if (type >= (uint32_t)NUM_TYPES) return;
+            for (uint32_t i = start[type]; i < end[type]; ++i) fn((int)i);
+            return;
+        }
+        auto it = std::lower_bound(order.begin(), order.end(), type, [&](uint32_t i, uint32_t t) {
+            return locs[i].field_0.m_type < t;
+        });
+        for (; it != order.end() && locs[*it].field_0.m_type == type; ++it) fn((int)*it);
+    }
+};
+
+// ==================== Reader ====================
+
+// Header and directory of a pack, copied out; payloads stay in the mapping
+struct ParsedPack {
+    MappedFile raw;   // read-only view of the whole pack; payloads are never copied
+    
+    resource_pack_header pack_header{};
+    generic_mash_header  mash_header{};
+    resource_directory   dir{};
+    
+    std::vector<int32_t>             parents;
+    std::vector<resource_location>   res_locs;
+    std::vector<tlresource_location> textures;
+    std::vector<tlresource_location> mesh_files;
+    std::vector<tlresource_location> meshes;
+    std::vector<tlresource_location> morph_files;
+    std::vector<tlresource_location> morphs;
+    std::vector<tlresource_location> material_files;
+    std::vector<tlresource_location> materials;
+    std::vector<tlresource_location> anim_files;
+    std::vector<tlresource_location> anims;
+    std::vector<tlresource_location> scene_anims;
+    std::vector<tlresource_location> skeletons;
+    
+    size_t res_locs_pos = 0;  // file offset of the resource_location array
+    ResourceIndex index;
+    
+    uint32_t base() const { return pack_header.res_dir_mash_size; }
+    int find(uint32_t hash, uint32_t type) const { return index.find(res_locs, hash, type); }
+    int find_first(uint32_t hash, uint32_t type) const { return index.find_first(res_locs, hash, type); }
+    
+    // Payload of resource i inside the mapping; throws when it runs past the end
+    ByteSpan payload(size_t i) const;
+};
+
+// Fills everything but P.raw from the first `size` bytes of a pack, which
+// must cover the header, the directory and its vectors.
+void parse_directory(ParsedPack& P, const uint8_t* data, size_t size);
+
+// Maps the whole pack and parses its directory
+ParsedPack parse_pcpack(const fs::path& path);
+
+// Reads only the header and directory area with unbuffered positioned reads
+// (pread, or ReadFile at an offset): the header, the directory, then
+// everything up to the end of the directory vectors. Payload bytes are never
+// touched, P.raw stays empty.
+ParsedPack read_pack_directory(const fs::path& path);
+
+// Every hash the pack may ask the dictionary about, sorted and unique
+std::vector<uint32_t> pack_name_hashes(const ParsedPack& P);
+
+// Calls fn(name, vector) for each of the eleven TL vectors in file order
+template<typename Pack, typename Fn>
+void for_each_tl_vector(Pack& P, Fn fn) {
+    fn("texture", P.textures);
+    fn("mesh_file", P.mesh_files);
+    fn("mesh", P.meshes);
+    fn("morph_file", P.morph_files);
+    fn("morph", P.morphs);
+    fn("material_file", P.material_files);
+    fn("material", P.materials);
+    fn("anim_file", P.anim_files);
+    fn("anim", P.anims);
+    fn("scene_anim", P.scene_anims);
+    fn("skeleton", P.skeletons);
+}
+
+// The TL vector that lists resources of this type, or null
+std::vector<tlresource_location>* tl_vector_for_type(ParsedPack& P, uint32_t type);
+
+// Moves every tlresource_location along with the payload it points into
+void update_tl_offsets(ParsedPack& P, const OffsetRemap& remap);
+
+// Header, mash header, directory and its vectors, padded up to base. Everything
+// a pack holds below its payloads.
+std::vector<uint8_t> serialize_directory(const ParsedPack& P);
+
+// ==================== Folder Names ====================
+
+struct ParsedName {
+    bool ok = false;
+    uint32_t hash = 0;
+    uint32_t type = 0;
+};
+
+// Key of a file in an export folder: NAME.EXT or 0xHASH.EXT. Names hash like
+// the game does, in the dictionary or not; `exceptions` (from
+// name_hash_exceptions) covers the entries that do not. stem_hash, when
+// given, is hash_string of the file's stem computed in bulk.
+ParsedName parse_folder_filename(const fs::path& p, const std::unordered_map<std::string, uint32_t>* exceptions,
+                                 const uint32_t* stem_hash = nullptr);
+
+// ==================== Payload Layout ====================
+
+enum PayloadLayout {
+    LAYOUT_ORIGINAL,   // repack from offset 0 in index order
+    LAYOUT_TYPE_HASH,  // repack sorted by type, then hash
+    LAYOUT_SIZE,       // repack fully aligned payloads first, largest first, then small ones
+    LAYOUT_BINPACK,    // repack in index order, small payloads filling the alignment gaps
+    LAYOUT_APPEND,     // keep payloads that fit, move grown ones to the end
+};
+
+extern const char* const layout_names[5];
+
+PayloadLayout parse_layout(const std::string& name);
+
+struct LayoutOptions {
+    PayloadLayout layout = LAYOUT_ORIGINAL;
+    size_t align = 16;
+    size_t small_align = 0;   // alignment of payloads smaller than align, 0 = align
+};
+
+struct LayoutItem {
+    uint32_t size;
+    uint32_t type;
+    uint32_t hash;
+};
+
+struct LayoutPlan {
+    std::vector<uint32_t> offsets;   // relative to base
+    uint64_t end = 0;                // end of the last payload
+    uint64_t padding = 0;            // bytes between payloads
+};
+
+// Offsets for a repacking layout (not LAYOUT_APPEND, which depends on the old
+// offsets). Payloads smaller than align only need small_align, which is what
+// lets one order beat another. Entries in shared_with take the offset of the
+// payload they share.
+LayoutPlan plan_payload_layout(const std::vector<LayoutItem>& items, const std::vector<int>& shared_with,
+                               PayloadLayout layout, size_t align, size_t small_align);
+
+// ==================== Payload Sources ====================
+
+// Where the bytes of one payload of a new pack come from
+struct PayloadSource {
+    ByteSpan bytes;            // in memory: inside the source pack or a caller's buffer
+    fs::path file;             // otherwise this whole file
+    uint64_t size = 0;
+    bool kept = false;         // untouched payload of the source pack
+    uint32_t old_offset = 0;   // where it was, for kept payloads
+};
+
+// Payload of resource i of the source pack, unchanged
+PayloadSource kept_payload(const ParsedPack& P, size_t i);
+
+// For every payload, the index of an earlier one whose stored copy it can
+// reuse (-1 for none). Kept payloads the source pack aliased (same old offset
+// and size) always stay shared; dedupe also merges identical content, found
+// by size and digest and confirmed byte for byte.
+struct SharedPayloads {
+    std::vector<int> with;
+    size_t   aliases = 0;
+    size_t   merged = 0;
+    uint64_t merged_bytes = 0;
+};
+SharedPayloads find_shared_payloads(const std::vector<PayloadSource>& payloads, bool dedupe);
+
+// ==================== Writer ====================
+
+// Output file of a rebuild. On Linux, payloads kept from the source pack are
+// copied by the kernel (copy_file_range) and never pass through user space;
+// runs that land at the same offset within a filesystem block are reflinked
+// with FICLONERANGE where the filesystem shares blocks (btrfs, XFS), and the
+// padding between payloads is left as holes. Every step falls back to plain
+// writes from the mapping when the kernel or filesystem refuses it.
+class PackWriter {
+public:
+    uint64_t cloned = 0, kernel_copied = 0, written = 0;
+    
+    PackWriter(const fs::path& path, const MappedFile& source);
+    ~PackWriter();
+    PackWriter(const PackWriter&) = delete;
+    PackWriter& operator=(const PackWriter&) = delete;
+    
+    uint64_t position() const { return pos; }
+    
+    void write(const void* data, size_t n);
+    
+    // Zero fill up to target
+    void pad_to(uint64_t target);
+    
+    // Copies n bytes of the source pack starting at src_off
+    void copy_source(uint64_t src_off, uint64_t n);
+    
+    // Copies exactly n bytes of file
+    void copy_file(const fs::path& file, uint64_t n, std::vector<char>& buf);
+    
+    void close();
+    
+private:
+    uint64_t kernel_copy(int in, uint64_t off, uint64_t n);
+    void copy_range(int in, uint64_t off, uint64_t n);
+    bool clone_range(uint64_t src_off, uint64_t n);
+    
+    fs::path path;
+    const MappedFile& source;
+    uint64_t pos = 0;
+    int fd = -1;
+    uint64_t end = 0;       // bytes actually in the file; pos runs ahead over holes
+    uint64_t block = 4096;
+    bool can_clone = true;
+    bool can_copy = true;
+    std::ofstream of;       // where there is no descriptor path
+};
+
+struct WriteStats {
+    uint64_t size = 0;
+    uint64_t directory = 0;   // bytes below base as serialized
+    uint64_t cloned = 0, kernel_copied = 0, written = 0;
+};
+
+// Writes a whole pack: the directory of P (already holding the new offsets
+// and sizes), then every payload in offset order from its source. Payloads
+// in shared_with are stored once, with the entry they share. Kept payloads
+// must point into P.raw.
+WriteStats write_pack(const fs::path& path, const ParsedPack& P, const std::vector<PayloadSource>& payloads,
+                      const std::vector<int>& shared_with);
+
+// ==================== Reimport ====================
+
+// Folder sync: every file of an export folder replaces the resource of the
+// same key, files with new keys become new resources (with a TL entry when
+// their type has a TL vector), and resources without a file are kept.
+// Entries end up sorted by type then hash. Files that still hold their
+// original payload are kept as they are.
+struct ReimportResult {
+    std::vector<PayloadSource> payloads;   // one per new resource_location
+    SharedPayloads shared;
+    uint64_t padding = 0;                  // of the chosen layout
+    uint64_t original_padding = 0;         // of index order at full alignment
+    size_t updated = 0, unchanged = 0, added = 0, skipped = 0;
+};
+
+// Rewrites the directory of P for the folder in place; write it out with
+// write_pack(path, P, r.payloads, r.shared.with).
+ReimportResult plan_reimport(ParsedPack& P, const fs::path& folder,
+                             const std::unordered_map<std::string, uint32_t>& exceptions,
+                             const LayoutOptions& layout, bool dedupe);
+
+} // namespace pcpack
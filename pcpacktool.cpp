@@ -2,634 +2,3355 @@
 // Handles the 0x1020 byte header structure and updates ALL location offsets
 //
 // Build (MinGW/Linux):
-//   g++ -std=c++17 -O2 pcpack_tool.cpp -o pcpack_tool
+//   g++ -std=c++17 -O2 -pthread pcpack_tool.cpp libpcpack/pcpack.cpp -o pcpack_tool
 // Build (MSVC):
-//   cl /std:c++17 /O2 pcpack_tool.cpp
+//   cl /std:c++17 /O2 pcpack_tool.cpp libpcpack\pcpack.cpp
+// Build (CMake):
+//   cmake -S . -B build && cmake --build build
+// mount needs libfuse3: add -DPCPACK_WITH_FUSE $(pkg-config --cflags --libs fuse3) to the
+// g++ line, or configure CMake with -DPCPACK_WITH_FUSE=ON
 //
 // Usage:
-//   pcpack_tool export <input.pcpack> [output_dir] [dict.txt]
-//   pcpack_tool import <original.pcpack> <input_dir> <output.pcpack> [--align N]
+//   pcpack_tool export <input.pcpack> [output_dir] [dict.txt] [--jobs N]
+//   pcpack_tool import <original.pcpack> <input_dir> <output.pcpack> [--align N] [--dict dict.txt] [--in-place] [--dedupe]
+//                       [--layout L] [--small-align N] [--reuse-holes]
+//   pcpack_tool reimport <original.pcpack> <folder> <output.pcpack> [--align N] [--dict dict.txt] [--dedupe]
+//                         [--layout L] [--small-align N]
+//   pcpack_tool batch <jobs.txt> [--jobs N] [--dict dict.txt] [--verbose]
+//   pcpack_tool batch export|import <pack|glob> ... [--jobs N] [--dict dict.txt]
+//   pcpack_tool info <pack|glob>...
+//   pcpack_tool list <input.pcpack> [dict.txt]
+//   pcpack_tool extract <input.pcpack> <name|0xHASH>[.EXT] [-o file|-]
+//   pcpack_tool mount <input.pcpack> <mountpoint> [--dict dict.txt] [-f] [-d] [-o opts]
+//   pcpack_tool diffpatch create <old.pcpack> <new.pcpack> <patch.pcpd>
+//   pcpack_tool diffpatch apply <old.pcpack> <patch.pcpd> <output.pcpack>
+//   pcpack_tool catalog build <game_dir> <catalog.pcct> [--jobs N] [--digests]
+//   pcpack_tool catalog find <catalog.pcct> <name|0xHASH>[.EXT]...
+//   pcpack_tool dict compile <dict.txt> <dict.bin>
+//   pcpack_tool dict verify <dict.txt|dict.bin> [--jobs N]
+//   pcpack_tool crack <pack|glob>... --dict dict.txt [--words list] [--dict-words] [--prefixes list]
+//                     [--suffixes list] [--sep chars] [--combine N] [--charset chars] [--min-len N]
+//                     [--max-len N] [--jobs N] [--write] [--out dict.txt]
+//   pcpack_tool bench remap [entries]
+//   pcpack_tool bench pack [--resources N] [--tl N] [--min-size B] [--max-size B] [--dist log|uniform]
+//                          [--seed S] [--jobs N] [--dir work_dir] [--keep]
+//   pcpack_tool bench layout [--resources N] [--min-size B] [--max-size B] [--dist log|uniform]
+//                            [--seed S] [--align N] [--small-align N] [--dir work_dir] [--keep]
+//   pcpack_tool bench catalog [--packs N] [--resources N] [--min-size B] [--max-size B] [--seed S]
+//                             [--lookups N] [--jobs N] [--dir work_dir] [--keep]
+//   pcpack_tool bench io [--resources N] [--min-size B] [--max-size B] [--dist log|uniform]
+//                        [--seed S] [--jobs N] [--dir work_dir] [--keep]
+//   any command: [--trace trace.json] [--stats]
 
 #include <cstdint>
 #include <cstdio>
+#include <cstdarg>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include <array>
 #include <vector>
+#include <map>
 #include <unordered_map>
 #include <fstream>
-#include <sstream>
+#include <cctype>
 #include <filesystem>
 #include <algorithm>
 #include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <new>
 
-namespace fs = std::filesystem;
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#if __has_include(<linux/io_uring.h>)
+#define PCPACK_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
 
-// ==================== Structures ====================
+#ifdef PCPACK_WITH_FUSE
+#define FUSE_USE_VERSION 31
+#include <fuse.h>
+#include <cerrno>
+#endif
 
-#pragma pack(push, 1)
+#include "libpcpack/pcpack.h"
 
-struct resource_versions {
-    uint32_t field_0, field_4, field_8, field_C, field_10;
+using namespace pcpack;
+
+// ==================== Helpers ====================
+
+// Progress output of a single export or import; batch runs turn it off
+static bool g_verbose = true;
+
+static void report(const char* fmt, ...) {
+    if (!g_verbose) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Largest resident set of the process so far, in KB
+static uint64_t peak_rss_kb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize / 1024;
+    return 0;
+#else
+    struct rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return (uint64_t)ru.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return (uint64_t)ru.ru_maxrss;
+#endif
+#endif
+}
+
+// Resident set of the process right now, in KB; 0 where it is not known
+static uint64_t current_rss_kb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.WorkingSetSize / 1024;
+    return 0;
+#elif defined(__linux__)
+    unsigned long long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    int n = fscanf(f, "%llu %llu", &pages, &resident);
+    fclose(f);
+    return n == 2 ? resident * (uint64_t)sysconf(_SC_PAGESIZE) / 1024 : 0;
+#else
+    return 0;
+#endif
+}
+
+// Largest resident set between construction and finish(), in KB. On Linux
+// the kernel's high-water mark is reset (clear_refs) and read back from
+// VmHWM; elsewhere, or when the reset is refused, a thread samples the
+// current resident set every millisecond.
+class RssPeakProbe {
+public:
+    RssPeakProbe() {
+#ifdef __linux__
+        if (FILE* f = fopen("/proc/self/clear_refs", "w")) {
+            kernel_hwm = fputs("5", f) >= 0;
+            kernel_hwm = fclose(f) == 0 && kernel_hwm;
+        }
+#endif
+        if (!kernel_hwm) {
+            peak = current_rss_kb();
+            sampler = std::thread([this] {
+                while (!stop.load(std::memory_order_relaxed)) {
+                    note(current_rss_kb());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+        }
+    }
+    ~RssPeakProbe() { finish(); }
+    
+    uint64_t finish() {
+        if (sampler.joinable()) {
+            stop.store(true, std::memory_order_relaxed);
+            sampler.join();
+        }
+        uint64_t kb = kernel_hwm ? vm_hwm_kb() : 0;
+        note(std::max(kb, current_rss_kb()));
+        return peak.load(std::memory_order_relaxed);
+    }
+    
+private:
+    static uint64_t vm_hwm_kb() {
+        uint64_t kb = 0;
+        if (FILE* f = fopen("/proc/self/status", "r")) {
+            char line[256];
+            while (fgets(line, sizeof(line), f)) {
+                unsigned long long v = 0;
+                if (sscanf(line, "VmHWM: %llu", &v) == 1) { kb = v; break; }
+            }
+            fclose(f);
+        }
+        return kb;
+    }
+    
+    void note(uint64_t kb) {
+        uint64_t cur = peak.load(std::memory_order_relaxed);
+        while (kb > cur && !peak.compare_exchange_weak(cur, kb, std::memory_order_relaxed)) {}
+    }
+    
+    bool kernel_hwm = false;
+    std::atomic<uint64_t> peak{0};
+    std::atomic<bool> stop{false};
+    std::thread sampler;
+};
+
+// Bytes the process moved through read/write-style calls (rchar/wchar on
+// Linux, transfer counts on Windows) and, on Linux, what actually reached
+// storage; mapped payloads only show up in the storage figure.
+struct ProcessIo {
+    bool     valid = false;
+    uint64_t read = 0, written = 0;
+    uint64_t storage_read = 0, storage_written = 0;
+};
+
+static ProcessIo process_io() {
+    ProcessIo io;
+#ifdef _WIN32
+    IO_COUNTERS c{};
+    if (GetProcessIoCounters(GetCurrentProcess(), &c)) {
+        io.valid = true;
+        io.read = c.ReadTransferCount;
+        io.written = c.WriteTransferCount;
+    }
+#elif defined(__linux__)
+    std::ifstream in("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (in >> key >> value) {
+        io.valid = true;
+        if (key == "rchar:") io.read = value;
+        else if (key == "wchar:") io.written = value;
+        else if (key == "read_bytes:") io.storage_read = value;
+        else if (key == "write_bytes:") io.storage_written = value;
+    }
+#endif
+    return io;
+}
+
+// Heap allocations for --stats. Every global operator new and delete is
+// replaced so that all of them agree on malloc/free. ~RunReport switches
+// counting off while FUSE workers may still allocate, hence the atomic flag.
+static std::atomic<bool> g_count_allocs{false};
+static std::atomic<uint64_t> g_allocs{0};
+static std::atomic<uint64_t> g_alloc_bytes{0};
+
+static void count_alloc(size_t n) {
+    if (g_count_allocs.load(std::memory_order_relaxed)) {
+        g_allocs.fetch_add(1, std::memory_order_relaxed);
+        g_alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+static void* alloc_or_null(size_t n, size_t align) {
+    if (n == 0) n = 1;
+    if (align <= alignof(std::max_align_t)) return malloc(n);
+#ifdef _WIN32
+    return _aligned_malloc(n, align);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, align, n) == 0 ? p : nullptr;
+#endif
+}
+
+static void* alloc_or_throw(size_t n, size_t align) {
+    count_alloc(n);
+    for (;;) {
+        if (void* p = alloc_or_null(n, align)) return p;
+        std::new_handler h = std::get_new_handler();
+        if (!h) throw std::bad_alloc();
+        h();
+    }
+}
+
+static void* alloc_nothrow(size_t n, size_t align) noexcept {
+    try {
+        return alloc_or_throw(n, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+static void release(void* p, size_t align) noexcept {
+#ifdef _WIN32
+    if (align > alignof(std::max_align_t)) { _aligned_free(p); return; }
+#else
+    (void)align;
+#endif
+    free(p);
+}
+
+// GCC sees free() on memory from operator new once these are inlined and
+// warns; the pairing is correct because all of them go through malloc.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static const size_t k_default_align = alignof(std::max_align_t);
+
+void* operator new(size_t n) { return alloc_or_throw(n, k_default_align); }
+void* operator new[](size_t n) { return alloc_or_throw(n, k_default_align); }
+void* operator new(size_t n, std::align_val_t a) { return alloc_or_throw(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a) { return alloc_or_throw(n, (size_t)a); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return alloc_nothrow(n, k_default_align); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return alloc_nothrow(n, k_default_align); }
+void* operator new(size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return alloc_nothrow(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return alloc_nothrow(n, (size_t)a); }
+
+void operator delete(void* p) noexcept { release(p, k_default_align); }
+void operator delete[](void* p) noexcept { release(p, k_default_align); }
+void operator delete(void* p, size_t) noexcept { release(p, k_default_align); }
+void operator delete[](void* p, size_t) noexcept { release(p, k_default_align); }
+void operator delete(void* p, std::align_val_t a) noexcept { release(p, (size_t)a); }
+void operator delete[](void* p, std::align_val_t a) noexcept { release(p, (size_t)a); }
+void operator delete(void* p, size_t, std::align_val_t a) noexcept { release(p, (size_t)a); }
+void operator delete[](void* p, size_t, std::align_val_t a) noexcept { release(p, (size_t)a); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p, k_default_align); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p, k_default_align); }
+void operator delete(void* p, std::align_val_t a, const std::nothrow_t&) noexcept { release(p, (size_t)a); }
+void operator delete[](void* p, std::align_val_t a, const std::nothrow_t&) noexcept { release(p, (size_t)a); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Removes "--name value" from args and returns the value, or def when absent.
+static std::string take_option(std::vector<std::string>& args, const char* name, const std::string& def = "") {
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        if (args[i] == name) {
+            std::string v = args[i + 1];
+            args.erase(args.begin() + i, args.begin() + i + 2);
+            return v;
+        }
+    }
+    return def;
+}
+
+// Removes "--name" from args and returns whether it was there.
+static bool take_flag(std::vector<std::string>& args, const char* name) {
+    auto it = std::find(args.begin(), args.end(), name);
+    if (it == args.end()) return false;
+    args.erase(it);
+    return true;
+}
+
+// Case-insensitive match of name against a pattern with * and ?
+static bool wildcard_match(const char* pat, const char* name) {
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while (*name) {
+        if (*pat == '*') {
+            star = pat++;
+            resume = name;
+        } else if (*pat == '?' || tolower((unsigned char)*pat) == tolower((unsigned char)*name)) {
+            ++pat; ++name;
+        } else if (star) {
+            pat = star + 1;
+            name = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pat == '*') ++pat;
+    return *pat == 0;
+}
+
+// Files matching a wildcard in the last path component, sorted by name
+static std::vector<fs::path> expand_glob(const fs::path& pattern) {
+    std::string name = pattern.filename().string();
+    if (name.find_first_of("*?") == std::string::npos) return { pattern };
+    
+    fs::path dir = pattern.parent_path();
+    std::vector<fs::path> files;
+    for (auto& de : fs::directory_iterator(dir.empty() ? fs::path(".") : dir)) {
+        if (de.is_regular_file() && wildcard_match(name.c_str(), de.path().filename().string().c_str()))
+            files.push_back(dir / de.path().filename());
+    }
+    if (files.empty()) throw std::runtime_error("No files match: " + pattern.string());
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Runs fn(i) for every i in [0, count) on up to `jobs` threads. Workers claim
+// the next index from a shared cursor, so a few large payloads cannot leave
+// the other threads idle. jobs == 0 means one thread per hardware core.
+// With a trace name each thread's share of the work is one trace event.
+template<typename Fn>
+static void parallel_for(size_t count, unsigned jobs, Fn fn, const char* trace = nullptr) {
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+    if (jobs > count) jobs = (unsigned)count;
+    if (jobs <= 1) {
+        TraceScope scope(trace);
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        TraceScope scope(trace);
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            fn(i);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < jobs; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+}
+
+// ==================== Batched I/O ====================
+// Export writes and import digest checks touch one small file per resource.
+// On Linux they go through io_uring: opens, reads/writes and closes of a whole
+// batch are submitted together, so a batch costs a few system calls instead
+// of several per file. Reads land in registered buffers. Without io_uring
+// (other systems, old kernels, sandboxes that block it) every file goes
+// through the standard streams as before.
+
+enum IoBackend { IO_AUTO, IO_URING, IO_STD };
+static IoBackend g_io_backend = IO_AUTO;
+
+static IoBackend parse_io_backend(const std::string& name) {
+    if (name == "auto") return IO_AUTO;
+    if (name == "uring") return IO_URING;
+    if (name == "std") return IO_STD;
+    throw std::runtime_error("Unknown I/O backend: " + name);
+}
+
+#ifdef PCPACK_HAVE_IO_URING
+// Just enough of io_uring through raw system calls: one submission and one
+// completion ring, optional registered buffers
+class IoRing {
+public:
+    IoRing() = default;
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+    ~IoRing() {
+        if (sqes) munmap(sqes, sqes_size);
+        if (cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        if (sq_ptr) munmap(sq_ptr, sq_size);
+        if (fd >= 0) close(fd);
+    }
+    
+    // False when the kernel has no io_uring or lacks one of the opcodes used here
+    bool init(unsigned entries, size_t buf_size = 0) {
+        io_uring_params p{};
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0) return false;
+        
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sq_size = cq_size = std::max(sq_size, cq_size);
+        void* sq = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq == MAP_FAILED) return false;
+        sq_ptr = (uint8_t*)sq;
+        if (single) {
+            cq_ptr = sq_ptr;
+        } else {
+            void* cq = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED) return false;
+            cq_ptr = (uint8_t*)cq;
+        }
+        sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) return false;
+        sqes = (io_uring_sqe*)s;
+        
+        sq_head  = (unsigned*)(sq_ptr + p.sq_off.head);
+        sq_tail  = (unsigned*)(sq_ptr + p.sq_off.tail);
+        sq_mask  = *(unsigned*)(sq_ptr + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq_ptr + p.sq_off.array);
+        cq_head  = (unsigned*)(cq_ptr + p.cq_off.head);
+        cq_tail  = (unsigned*)(cq_ptr + p.cq_off.tail);
+        cq_mask  = *(unsigned*)(cq_ptr + p.cq_off.ring_mask);
+        cqes     = (io_uring_cqe*)(cq_ptr + p.cq_off.cqes);
+        capacity = p.sq_entries;
+        tail = *sq_tail;
+        
+        std::vector<uint8_t> probe_mem(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = (io_uring_probe*)probe_mem.data();
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        for (unsigned op : { IORING_OP_OPENAT, IORING_OP_CLOSE, IORING_OP_WRITE, IORING_OP_READ_FIXED }) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        
+        if (buf_size) {
+            buffers.resize((size_t)capacity * buf_size);
+            std::vector<iovec> iov(capacity);
+            for (unsigned i = 0; i < capacity; ++i) iov[i] = { buffers.data() + i * buf_size, buf_size };
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov.data(), capacity) < 0) return false;
+            buffer_size = buf_size;
+        }
+        return true;
+    }
+    
+    unsigned size() const { return capacity; }
+    uint8_t* buffer(unsigned i) { return buffers.data() + (size_t)i * buffer_size; }
+    size_t buffer_bytes() const { return buffer_size; }
+    
+    // False once io_uring_enter has failed; the ring must not be used again
+    bool broken() const { return failed; }
+    
+    // Submits count operations (at most size()) and waits for all of them.
+    // prep(i, sqe) fills operation i, done(i, res) receives its result.
+    // When io_uring_enter fails the ring is marked broken: operations of
+    // this call may still be queued or in flight, and a later call would
+    // submit them again or see their completions as its own. Completions
+    // already posted are still handed to done.
+    template<typename Prep, typename Done>
+    bool run(size_t count, Prep prep, Done done) {
+        if (failed) return false;
+        if (count == 0) return true;
+        for (size_t i = 0; i < count; ++i) {
+            io_uring_sqe* sqe = &sqes[tail & sq_mask];
+            memset(sqe, 0, sizeof(*sqe));
+            prep(i, sqe);
+            sqe->user_data = i;
+            sq_array[tail & sq_mask] = tail & sq_mask;
+            tail++;
+        }
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+        
+        size_t submitted = 0, completed = 0;
+        while (completed < count) {
+            unsigned to_submit = (unsigned)(count - submitted);
+            long r = syscall(__NR_io_uring_enter, fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                failed = true;
+                reap(done);
+                return false;
+            }
+            submitted += (size_t)r;
+            completed += reap(done);
+        }
+        return true;
+    }
+    
+private:
+    // Hands every posted completion to done and returns how many there were
+    template<typename Done>
+    size_t reap(Done& done) {
+        unsigned head = *cq_head;
+        unsigned ctail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        size_t n = 0;
+        for (; head != ctail; ++head, ++n) {
+            const io_uring_cqe& cqe = cqes[head & cq_mask];
+            done((size_t)cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        return n;
+    }
+    
+    int fd = -1;
+    bool failed = false;
+    uint8_t* sq_ptr = nullptr;
+    uint8_t* cq_ptr = nullptr;
+    size_t sq_size = 0, cq_size = 0, sqes_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned sq_mask = 0, cq_mask = 0, capacity = 0, tail = 0;
+    std::vector<uint8_t> buffers;
+    size_t buffer_size = 0;
+};
+
+// Opens paths[0..n) with flags; fds[i] stays -1 when that open failed
+static bool uring_open_all(IoRing& ring, const std::vector<std::string>& paths, int flags, std::vector<int>& fds) {
+    fds.assign(paths.size(), -1);
+    return ring.run(paths.size(), [&](size_t i, io_uring_sqe* sqe) {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)(uintptr_t)paths[i].c_str();
+        sqe->len = 0644;
+        sqe->open_flags = (uint32_t)(flags | O_CLOEXEC);
+    }, [&](size_t i, int res) { if (res >= 0) fds[i] = res; });
+}
+
+// Closes every open fd; a failed close fails that file
+static bool uring_close_all(IoRing& ring, std::vector<int>& fds, std::vector<uint8_t>& ok) {
+    std::vector<size_t> open;
+    for (size_t i = 0; i < fds.size(); ++i) {
+        if (fds[i] >= 0) open.push_back(i);
+    }
+    bool ran = ring.run(open.size(), [&](size_t k, io_uring_sqe* sqe) {
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fds[open[k]];
+    }, [&](size_t k, int res) { if (res < 0) ok[open[k]] = 0; });
+    if (!ran) {
+        for (size_t i : open) close(fds[i]);
+    }
+    return ran;
+}
+#endif
+
+// Whether batches should try io_uring. Probed once; forcing it where it is
+// missing is an error rather than a silent fallback.
+static bool use_io_uring() {
+    if (g_io_backend == IO_STD) return false;
+#ifdef PCPACK_HAVE_IO_URING
+    static const bool available = IoRing().init(8);
+#else
+    const bool available = false;
+#endif
+    if (!available && g_io_backend == IO_URING)
+        throw std::runtime_error("io_uring is not available on this system");
+    return available;
+}
+
+// Runs batch(b, ring) for every batch, one ring per worker thread. ring is
+// null when io_uring is not used, could not be set up for that worker, or
+// broke in an earlier batch of the same worker.
+template<typename Fn>
+static void for_each_batch(size_t batches, unsigned jobs, unsigned ring_entries, size_t buf_size, Fn batch) {
+    const bool uring = use_io_uring();
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+    const size_t workers = std::max<size_t>(1, std::min<size_t>(jobs, batches));
+    parallel_for(workers, (unsigned)workers, [&](size_t w) {
+#ifdef PCPACK_HAVE_IO_URING
+        IoRing ring;
+        IoRing* rp = uring && ring.init(ring_entries, buf_size) ? &ring : nullptr;
+        for (size_t b = w; b < batches; b += workers) {
+            if (rp && rp->broken()) rp = nullptr;
+            batch(b, rp);
+        }
+#else
+        (void)uring; (void)ring_entries; (void)buf_size;
+        void* rp = nullptr;
+        for (size_t b = w; b < batches; b += workers) batch(b, rp);
+#endif
+    });
+}
+
+struct FileWrite {
+    fs::path path;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Writes every file whole and returns which ones made it
+static std::vector<uint8_t> write_files(const std::vector<FileWrite>& files, unsigned jobs) {
+    TraceScope trace("write_files");
+    std::vector<uint8_t> ok(files.size(), 1);
+    const size_t BATCH = 256;
+    
+    for_each_batch((files.size() + BATCH - 1) / BATCH, jobs, (unsigned)BATCH, 0, [&](size_t b, auto* ring) {
+        TraceScope batch_trace("write_batch");
+        const size_t first = b * BATCH, n = std::min(BATCH, files.size() - first);
+#ifdef PCPACK_HAVE_IO_URING
+        if (ring) {
+            std::vector<std::string> paths(n);
+            for (size_t i = 0; i < n; ++i) paths[i] = files[first + i].path.string();
+            std::vector<int> fds;
+            std::vector<uint8_t> bok(n, 1);
+            std::vector<size_t> done(n, 0);
+            bool ran = uring_open_all(*ring, paths, O_WRONLY | O_CREAT | O_TRUNC, fds);
+            
+            // Writes until every file is complete; a short write just goes again
+            std::vector<size_t> pending;
+            for (size_t i = 0; i < n; ++i) {
+                if (fds[i] < 0) bok[i] = 0;
+                else if (files[first + i].size > 0) pending.push_back(i);
+            }
+            while (ran && !pending.empty()) {
+                ran = ring->run(pending.size(), [&](size_t k, io_uring_sqe* sqe) {
+                    size_t i = pending[k];
+                    sqe->opcode = IORING_OP_WRITE;
+                    sqe->fd = fds[i];
+                    sqe->addr = (uint64_t)(uintptr_t)(files[first + i].data + done[i]);
+                    sqe->len = (uint32_t)std::min<size_t>(files[first + i].size - done[i], 1u << 30);
+                    sqe->off = done[i];
+                }, [&](size_t k, int res) {
+                    size_t i = pending[k];
+                    if (res <= 0) bok[i] = 0;
+                    else done[i] += (size_t)res;
+                });
+                std::vector<size_t> next;
+                for (size_t i : pending) {
+                    if (bok[i] && done[i] < files[first + i].size) next.push_back(i);
+                }
+                pending.swap(next);
+            }
+            ran = uring_close_all(*ring, fds, bok) && ran;
+            if (ran) {
+                std::copy(bok.begin(), bok.end(), ok.begin() + first);
+                return;
+            }
+        }
+#else
+        (void)ring;
+#endif
+        for (size_t i = first; i < first + n; ++i) {
+            std::ofstream of(files[i].path, std::ios::binary);
+            if (of) of.write((const char*)files[i].data, files[i].size);
+            ok[i] = of ? 1 : 0;
+        }
+    });
+    return ok;
+}
+
+// XXH64 of every whole file; ok[i] is 0 when it could not be read
+static std::vector<uint64_t> digest_files(const std::vector<fs::path>& paths, std::vector<uint8_t>& ok, unsigned jobs) {
+    TraceScope trace("digest_files");
+    std::vector<uint64_t> digests(paths.size(), 0);
+    ok.assign(paths.size(), 1);
+    const size_t BATCH = 64;
+    const size_t BUF = 64 * 1024;
+    
+    for_each_batch((paths.size() + BATCH - 1) / BATCH, jobs, (unsigned)BATCH, BUF, [&](size_t b, auto* ring) {
+        TraceScope batch_trace("digest_batch");
+        const size_t first = b * BATCH, n = std::min(BATCH, paths.size() - first);
+#ifdef PCPACK_HAVE_IO_URING
+        if (ring) {
+            std::vector<std::string> names(n);
+            for (size_t i = 0; i < n; ++i) names[i] = paths[first + i].string();
+            std::vector<int> fds;
+            std::vector<uint8_t> bok(n, 1);
+            std::vector<Xxh64> state(n);
+            std::vector<uint64_t> pos(n, 0);
+            bool ran = uring_open_all(*ring, names, O_RDONLY, fds);
+            
+            // One registered buffer per file, refilled until the read hits the end
+            std::vector<size_t> pending;
+            for (size_t i = 0; i < n; ++i) {
+                if (fds[i] < 0) bok[i] = 0;
+                else pending.push_back(i);
+            }
+            while (ran && !pending.empty()) {
+                std::vector<size_t> next;
+                ran = ring->run(pending.size(), [&](size_t k, io_uring_sqe* sqe) {
+                    size_t i = pending[k];
+                    sqe->opcode = IORING_OP_READ_FIXED;
+                    sqe->fd = fds[i];
+                    sqe->addr = (uint64_t)(uintptr_t)ring->buffer((unsigned)i);
+                    sqe->len = (uint32_t)ring->buffer_bytes();
+                    sqe->off = pos[i];
+                    sqe->buf_index = (uint16_t)i;
+                }, [&](size_t k, int res) {
+                    size_t i = pending[k];
+                    if (res < 0) { bok[i] = 0; return; }
+                    if (res == 0) return;
+                    state[i].update(ring->buffer((unsigned)i), (size_t)res);
+                    pos[i] += (uint64_t)res;
+                    next.push_back(i);
+                });
+                pending.swap(next);
+            }
+            ran = uring_close_all(*ring, fds, bok) && ran;
+            if (ran) {
+                for (size_t i = 0; i < n; ++i) {
+                    ok[first + i] = bok[i];
+                    digests[first + i] = state[i].digest();
+                }
+                return;
+            }
+        }
+#else
+        (void)ring;
+#endif
+        std::vector<char> buf(1 << 20);
+        for (size_t i = first; i < first + n; ++i) {
+            try { digests[i] = xxh64_file(paths[i], buf); }
+            catch (const std::exception&) { ok[i] = 0; }
+        }
+    });
+    return digests;
+}
+
+// ==================== Hash Dictionary ====================
+
+static HashDictionary g_hashDict;
+
+// Accepts either the text dictionary or a file written by `dict compile`.
+// A compiled dictionary is mapped as a whole: names that are never looked
+// up are never read.
+static void load_hash_dictionary(const fs::path& path, const std::vector<uint32_t>* wanted = nullptr) {
+    if (path.empty() || !fs::exists(path)) return;
+    load_dictionary(g_hashDict, path, wanted);
+    printf("Loaded %zu hash entries from dictionary\n", g_hashDict.size());
+}
+
+static void compile_hash_dictionary(const fs::path& txt_path, const fs::path& out_path) {
+    HashDictionary d;
+    load_text_dictionary(d, txt_path);
+    write_compiled_dictionary(d, out_path);
+    printf("Compiled %zu hash entries into %s (%zu bytes of names)\n",
+           d.count, out_path.string().c_str(), d.blob_size);
+}
+
+// Recomputes the hash of every dictionary name in parallel and lists the
+// entries whose stored hash differs. Returns how many differ.
+static size_t verify_hash_dictionary(const fs::path& path, unsigned jobs) {
+    if (!fs::exists(path)) throw std::runtime_error("Cannot open: " + path.string());
+    load_hash_dictionary(path);
+    const HashDictionary& d = g_hashDict;
+    
+    std::vector<std::string_view> names(d.count);
+    for (size_t i = 0; i < d.count; ++i) names[i] = d.blob + d.offsets[i];
+    std::vector<uint32_t> computed(d.count);
+    
+    const size_t BLOCK = 4096;
+    auto t0 = std::chrono::steady_clock::now();
+    parallel_for((d.count + BLOCK - 1) / BLOCK, jobs, [&](size_t b) {
+        size_t start = b * BLOCK;
+        hash_strings(&names[start], std::min(BLOCK, d.count - start), &computed[start]);
+    }, "hash_names");
+    double sec = seconds_since(t0);
+    
+    size_t bad = 0;
+    for (size_t i = 0; i < d.count; ++i) {
+        if (computed[i] == d.hashes[i]) continue;
+        printf("  0x%08x  %s  (hashes to 0x%08x)\n", d.hashes[i], d.blob + d.offsets[i], computed[i]);
+        bad++;
+    }
+    printf("%zu entries: %zu match, %zu differ (%.1f ms)\n", d.count, d.count - bad, bad, sec * 1000);
+    return bad;
+}
+
+static std::string get_filename(uint32_t hash, uint32_t type) {
+    return resource_filename(g_hashDict, hash, type);
+}
+
+// ==================== Export ====================
+
+// _manifest.txt, written by export and read back by import: a header, then
+// one line per exported resource in index order
+static std::string manifest_header(const ParsedPack& P) {
+    return "# PCPACK Manifest\n# base=" + std::to_string(P.base()) + "\n# resources=" + std::to_string(P.res_locs.size())
+         + "\n# index hash type offset size xxh64 filename\n\n";
+}
+
+static std::string manifest_line(size_t i, const resource_location& rl, uint64_t digest, const std::string& fname) {
+    char head[96];
+    snprintf(head, sizeof(head), "%zu 0x%x %u 0x%x 0x%x %016llx ", i, rl.field_0.m_hash.source_hash_code,
+             rl.field_0.m_type, rl.m_offset, rl.m_size, (unsigned long long)digest);
+    return head + fname + "\n";
+}
+
+static void do_export(const fs::path& pack_path, const fs::path& out_dir, const fs::path& dict_path,
+                      unsigned jobs) {
+    TraceScope trace("export", pack_path.string());
+    report("Parsing %s...\n", pack_path.string().c_str());
+    ParsedPack P = parse_pcpack(pack_path);
+    
+    std::vector<uint32_t> wanted = pack_name_hashes(P);
+    load_hash_dictionary(dict_path, &wanted);
+    
+    report("PCPACK Info:\n");
+    report("  Directory offset: 0x%X\n", P.pack_header.directory_offset);
+    report("  Base (payload start): 0x%X (%u)\n", P.base(), P.base());
+    report("  Resource locations: %zu\n", P.res_locs.size());
+    report("  Texture locations: %zu\n", P.textures.size());
+    report("  Mesh file locations: %zu\n", P.mesh_files.size());
+    report("  Mesh locations: %zu\n", P.meshes.size());
+    report("  Material locations: %zu\n", P.materials.size());
+    report("  Anim file locations: %zu\n", P.anim_files.size());
+    report("  Anim locations: %zu\n", P.anims.size());
+    report("  Skeleton locations: %zu\n", P.skeletons.size());
+    
+    fs::path target_dir = out_dir.empty() ? pack_path.stem() : out_dir;
+    fs::create_directories(target_dir);
+    
+    report("\nExporting %zu resources to %s\n", P.res_locs.size(), target_dir.string().c_str());
+    
+    // Resolve names up front. When two entries share a file name only the last
+    // one is written, exactly as the sequential export used to overwrite it.
+    enum ExportStatus : uint8_t { EXPORT_OK, EXPORT_OOB, EXPORT_WRITE_FAILED, EXPORT_SHADOWED };
+    std::vector<std::string> fnames(P.res_locs.size());
+    std::vector<ExportStatus> status(P.res_locs.size(), EXPORT_OK);
+    std::unordered_map<std::string, size_t> last_writer;
+    {
+        TraceScope names_trace("resolve_names");
+        for (size_t i = 0; i < P.res_locs.size(); ++i) {
+            const auto& rl = P.res_locs[i];
+            fnames[i] = sanitize_filename(get_filename(rl.field_0.m_hash.source_hash_code, rl.field_0.m_type));
+            uint64_t end = (uint64_t)P.base() + rl.m_offset + rl.m_size;
+            if (end > P.raw.size()) { status[i] = EXPORT_OOB; continue; }
+            auto ins = last_writer.emplace(fnames[i], i);
+            if (!ins.second) {
+                status[ins.first->second] = EXPORT_SHADOWED;
+                ins.first->second = i;
+            }
+        }
+    }
+    
+    // Digests go to the manifest so import can tell which files were edited
+    std::vector<uint64_t> digests(P.res_locs.size());
+    parallel_for(P.res_locs.size(), jobs, [&](size_t i) {
+        if (status[i] == EXPORT_OOB) return;
+        const auto& rl = P.res_locs[i];
+        digests[i] = xxh64(&P.raw[(size_t)P.base() + rl.m_offset], rl.m_size);
+    }, "digest_payloads");
+    
+    std::vector<FileWrite> writes;
+    std::vector<size_t> write_index;
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        if (status[i] != EXPORT_OK) continue;
+        const auto& rl = P.res_locs[i];
+        writes.push_back({ target_dir / fnames[i], &P.raw[(size_t)P.base() + rl.m_offset], rl.m_size });
+        write_index.push_back(i);
+    }
+    std::vector<uint8_t> written = write_files(writes, jobs);
+    for (size_t k = 0; k < writes.size(); ++k) {
+        if (!written[k]) status[write_index[k]] = EXPORT_WRITE_FAILED;
+    }
+    
+    // Export manifest file for reimport, in index order
+    TraceScope manifest_trace("write_manifest");
+    fs::path manifest_path = target_dir / "_manifest.txt";
+    std::ofstream manifest(manifest_path);
+    manifest << manifest_header(P);
+    
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        
+        if (status[i] == EXPORT_OOB) {
+            printf("  [%zu] WARNING: payload out of bounds (0x%llX > 0x%zX)\n",
+                   i, (unsigned long long)((uint64_t)P.base() + rl.m_offset + rl.m_size), P.raw.size());
+            continue;
+        }
+        if (status[i] == EXPORT_WRITE_FAILED) {
+            printf("  [%zu] ERROR: cannot write %s\n", i, fnames[i].c_str());
+            continue;
+        }
+        
+        manifest << manifest_line(i, rl, digests[i], fnames[i]);
+        
+        report("  [%zu] %s (0x%X bytes at offset 0x%X)%s\n",
+               i, fnames[i].c_str(), rl.m_size, rl.m_offset,
+               status[i] == EXPORT_SHADOWED ? " [name taken by a later entry]" : "");
+    }
+    
+    manifest.close();
+    report("\nExport complete. Manifest written to %s\n", manifest_path.string().c_str());
+}
+
+// ==================== List / Info ====================
+// Both read the header area only (read_pack_directory), never the payloads.
+
+static void do_info(const fs::path& pack_path) {
+    ParsedPack P = read_pack_directory(pack_path);
+    
+    uint64_t payload_bytes = 0;
+    std::vector<size_t> per_type(NUM_RESOURCE_TYPES + 1);
+    for (const auto& rl : P.res_locs) {
+        payload_bytes += rl.m_size;
+        per_type[std::min<size_t>(rl.field_0.m_type, NUM_RESOURCE_TYPES)]++;
+    }
+    
+    printf("%s\n", pack_path.string().c_str());
+    printf("  File size: %llu bytes\n", (unsigned long long)fs::file_size(pack_path));
+    printf("  Directory offset: 0x%X\n", P.pack_header.directory_offset);
+    printf("  Base (payload start): 0x%X (%u)\n", P.base(), P.base());
+    printf("  Payload bytes: %llu\n", (unsigned long long)payload_bytes);
+    printf("  Resource locations: %zu\n", P.res_locs.size());
+    printf("  Texture locations: %zu\n", P.textures.size());
+    printf("  Mesh file locations: %zu\n", P.mesh_files.size());
+    printf("  Mesh locations: %zu\n", P.meshes.size());
+    printf("  Morph file locations: %zu\n", P.morph_files.size());
+    printf("  Morph locations: %zu\n", P.morphs.size());
+    printf("  Material file locations: %zu\n", P.material_files.size());
+    printf("  Material locations: %zu\n", P.materials.size());
+    printf("  Anim file locations: %zu\n", P.anim_files.size());
+    printf("  Anim locations: %zu\n", P.anims.size());
+    printf("  Scene anim locations: %zu\n", P.scene_anims.size());
+    printf("  Skeleton locations: %zu\n", P.skeletons.size());
+    printf("  Resources by type:\n");
+    for (size_t t = 0; t < per_type.size(); ++t) {
+        if (per_type[t])
+            printf("    %-18s %zu\n", t < (size_t)NUM_RESOURCE_TYPES ? resource_type_ext[t] : "(unknown)", per_type[t]);
+    }
+}
+
+static void do_list(const fs::path& pack_path, const fs::path& dict_path) {
+    ParsedPack P = read_pack_directory(pack_path);
+    
+    std::vector<uint32_t> wanted = pack_name_hashes(P);
+    load_hash_dictionary(dict_path, &wanted);
+    
+    printf("index  hash        type  offset      size        name\n");
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        uint32_t hash = rl.field_0.m_hash.source_hash_code;
+        uint32_t type = rl.field_0.m_type;
+        printf("%5zu  0x%08X  %4u  0x%08X  0x%08X  %s\n",
+               i, hash, type, rl.m_offset, rl.m_size, get_filename(hash, type).c_str());
+    }
+}
+
+// ==================== Extract ====================
+
+// A resource named on the command line: a name or 0xHASH, optionally with
+// the extension of its type (type -1 without one)
+struct ResourceKey {
+    std::string name;
+    uint32_t    hash = 0;
+    int         type = -1;
+    bool        by_hash = false;
+};
+
+static ResourceKey parse_resource_key(const std::string& key) {
+    // Split off a known extension, longest first (.DDSMP before .DDS)
+    ResourceKey k;
+    k.name = key;
+    size_t best_len = 0;
+    for (size_t t = 0; t < (size_t)NUM_RESOURCE_TYPES; ++t) {
+        const std::string e = resource_type_ext[t];
+        if (e.size() < 2 || e[0] != '.' || e.size() >= key.size() || e.size() <= best_len) continue;
+        std::string tail = key.substr(key.size() - e.size());
+        std::transform(tail.begin(), tail.end(), tail.begin(), ::toupper);
+        if (tail == e) { k.type = (int)t; best_len = e.size(); }
+    }
+    if (k.type >= 0) k.name = key.substr(0, key.size() - best_len);
+    
+    k.by_hash = k.name.size() > 2 && k.name[0] == '0' && (k.name[1] == 'x' || k.name[1] == 'X');
+    if (k.by_hash) k.hash = (uint32_t)std::stoul(k.name.substr(2), nullptr, 16);
+    else k.hash = hash_string(k.name);
+    return k;
+}
+
+// Copies one resource out of a pack. key is a name or 0xHASH, optionally with
+// the extension of its type; without one the name must be unique in the pack.
+// Reads the directory and then only the payload range. out "-" is stdout.
+static void do_extract(const fs::path& pack_path, const std::string& key, const fs::path& out) {
+    TraceScope trace("extract", key);
+    const ResourceKey k = parse_resource_key(key);
+    const std::string& name = k.name;
+    const uint32_t hash = k.hash;
+    const int want_type = k.type;
+    const bool by_hash = k.by_hash;
+    
+    ParsedPack P = read_pack_directory(pack_path);
+    
+    int found = -1;
+    std::vector<uint32_t> types;
+    if (want_type >= 0) {
+        found = P.find(hash, (uint32_t)want_type);
+    } else {
+        for (uint32_t t = 0; t < (uint32_t)NUM_RESOURCE_TYPES; ++t) {
+            int i = P.find(hash, t);
+            if (i < 0) continue;
+            found = i;
+            types.push_back(t);
+        }
+    }
+    if (found < 0)
+        throw std::runtime_error("No resource " + key + " in " + pack_path.string());
+    if (types.size() > 1) {
+        std::string msg = key + " is ambiguous, add one of:";
+        for (uint32_t t : types) msg += std::string(" ") + get_ext(t);
+        throw std::runtime_error(msg);
+    }
+    
+    // Mapped but never touched on the way to a file: PackWriter hands the
+    // range to the kernel and only falls back to the mapping when refused
+    MappedFile source(pack_path);
+    const auto& rl = P.res_locs[found];
+    uint64_t start = (uint64_t)P.base() + rl.m_offset;
+    if (start + rl.m_size > source.size())
+        throw std::runtime_error("Corrupted pack: resource out of bounds");
+    
+    bool to_stdout = out == "-";
+    fs::path out_path = out;
+    if (out_path.empty())
+        out_path = sanitize_filename((by_hash ? get_filename(hash, rl.field_0.m_type) : name + get_ext(rl.field_0.m_type)));
+    
+    if (to_stdout) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        bool ok = fwrite(source.data() + start, 1, rl.m_size, stdout) == rl.m_size;
+        if (fflush(stdout) != 0 || !ok) throw std::runtime_error("Extract failed: " + key);
+    } else {
+        PackWriter of(out_path, source);
+        of.copy_source(start, rl.m_size);
+        of.close();
+    }
+    
+    if (!to_stdout)
+        fprintf(stderr, "Extracted [%d] %s (%u bytes) to %s\n", found, key.c_str(), rl.m_size, out_path.string().c_str());
+}
+
+// ==================== Import ====================
+
+// Copies exactly size bytes of src to of through buf
+static void copy_from_file(std::ostream& of, const fs::path& src, uint64_t size, std::vector<char>& buf) {
+    std::ifstream in(src, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open: " + src.string());
+    while (size > 0) {
+        size_t n = (size_t)std::min<uint64_t>(size, buf.size());
+        in.read(buf.data(), n);
+        if ((size_t)in.gcount() != n)
+            throw std::runtime_error("File changed while importing: " + src.string());
+        of.write(buf.data(), n);
+        size -= n;
+    }
+}
+
+// XXH64 of every payload as exported, read back from the _manifest.txt in
+// input_dir. Lines that no longer match the pack (other key, offset or size)
+// and manifests written before the digest column are ignored.
+struct ManifestDigests {
+    std::vector<uint64_t> digest;
+    std::vector<uint8_t>  known;
+};
+
+static ManifestDigests load_manifest_digests(const ParsedPack& P, const fs::path& input_dir) {
+    ManifestDigests md;
+    md.digest.resize(P.res_locs.size());
+    md.known.resize(P.res_locs.size(), 0);
+    
+    std::ifstream in(input_dir / "_manifest.txt");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        size_t index;
+        unsigned hash, type, offset, size;
+        unsigned long long digest;
+        int end = 0;
+        if (sscanf(line.c_str(), "%zu %x %u %x %x %16llx%n", &index, &hash, &type, &offset, &size, &digest, &end) != 6)
+            continue;
+        // A 16 digit token followed by the file name, not the start of an old-style name
+        if (line.c_str()[end] != ' ' || index >= P.res_locs.size()) continue;
+        const auto& rl = P.res_locs[index];
+        if (rl.field_0.m_hash.source_hash_code != hash || rl.field_0.m_type != type ||
+            rl.m_offset != offset || rl.m_size != size)
+            continue;
+        md.digest[index] = digest;
+        md.known[index] = 1;
+    }
+    return md;
+}
+
+struct Replacement {
+    fs::path file;            // empty when the original is kept
+    uint64_t size = 0;
+    bool unchanged = false;   // a file exists but holds the original payload
+};
+
+// Finds the replacement file of every resource. A file of the original size
+// whose digest matches the manifest (or the payload, without a manifest) is
+// unchanged and the original is kept, so a fresh export imports as a no-op.
+static std::vector<Replacement> find_replacements(const ParsedPack& P, const fs::path& input_dir,
+                                                  unsigned jobs, std::vector<std::string>* fnames = nullptr) {
+    TraceScope trace("find_replacements", input_dir.string());
+    ManifestDigests md = load_manifest_digests(P, input_dir);
+    std::vector<Replacement> reps(P.res_locs.size());
+    if (fnames) fnames->resize(P.res_locs.size());
+    
+    // Same-size files are digested together in one batch afterwards
+    std::vector<size_t> same_size;
+    std::vector<fs::path> check;
+    {
+        TraceScope names_trace("resolve_names");
+        for (size_t i = 0; i < P.res_locs.size(); ++i) {
+            const auto& rl = P.res_locs[i];
+            std::string fname = sanitize_filename(get_filename(rl.field_0.m_hash.source_hash_code, rl.field_0.m_type));
+            fs::path in_file = input_dir / fname;
+            if (fnames) (*fnames)[i] = fname;
+            
+            std::error_code ec;
+            uint64_t size = fs::file_size(in_file, ec);
+            if (ec) continue;
+            
+            if (size == rl.m_size) {
+                if (!md.known[i] && (uint64_t)P.base() + rl.m_offset + rl.m_size > P.raw.size())
+                    throw std::runtime_error("Corrupted pack: resource out of bounds");
+                same_size.push_back(i);
+                check.push_back(in_file);
+            }
+            reps[i].file = in_file;
+            reps[i].size = size;
+        }
+    }
+    
+    std::vector<uint8_t> readable;
+    std::vector<uint64_t> digests = digest_files(check, readable, jobs);
+    for (size_t k = 0; k < same_size.size(); ++k) {
+        size_t i = same_size[k];
+        if (!readable[k]) throw std::runtime_error("Cannot open: " + check[k].string());
+        const auto& rl = P.res_locs[i];
+        uint64_t expected = md.known[i] ? md.digest[i]
+                                        : xxh64(&P.raw[(size_t)P.base() + rl.m_offset], rl.m_size);
+        if (digests[k] == expected) reps[i] = Replacement{ {}, 0, true };
+    }
+    return reps;
+}
+
+struct ImportOptions {
+    size_t align = 16;
+    bool in_place = false;      // patch fitting replacements over their old slots
+    bool dedupe = false;        // store identical payloads once
+    PayloadLayout layout = LAYOUT_ORIGINAL;
+    bool reuse_holes = false;   // append layout: fill slots vacated by moved payloads
+    size_t small_align = 0;     // alignment of payloads smaller than align, 0 = align
+    unsigned jobs = 1;          // threads checking input files, 0 = all cores
+};
+
+// Room each payload has where it is now: up to the next payload start, or the
+// end of the file. -1 when another resource stores bytes at the same offset,
+// since those could not change for one of them alone.
+static std::vector<int64_t> payload_slots(const ParsedPack& P) {
+    const uint64_t payload_end = P.raw.size();
+    if (payload_end < P.base())
+        throw std::runtime_error("Corrupted pack: base past end of file");
+    
+    // Payload starts in file order, to find where each slot ends
+    std::vector<uint32_t> starts;
+    std::unordered_map<uint32_t, size_t> users;
+    starts.reserve(P.res_locs.size());
+    for (const auto& rl : P.res_locs) {
+        if ((uint64_t)P.base() + rl.m_offset + rl.m_size > payload_end)
+            throw std::runtime_error("Corrupted pack: resource out of bounds");
+        starts.push_back(rl.m_offset);
+        if (rl.m_size > 0) users[rl.m_offset]++;
+    }
+    std::sort(starts.begin(), starts.end());
+    
+    std::vector<int64_t> slots(P.res_locs.size());
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        auto next = std::upper_bound(starts.begin(), starts.end(), rl.m_offset);
+        uint64_t slot = (next != starts.end() ? *next : payload_end - P.base()) - rl.m_offset;
+        auto u = users.find(rl.m_offset);
+        size_t others = (u != users.end() ? u->second : 0) - (rl.m_size > 0 ? 1 : 0);
+        slots[i] = (slot < rl.m_size || others > 0) ? -1 : (int64_t)slot;
+    }
+    return slots;
+}
+
+// Offsets for --layout append. Kept payloads and replacements that fit their
+// slot stay where they are; the rest go to the end of the payload area or,
+// with reuse_holes, into the first vacated slot with room. Entries in
+// shared_with take the offset of the payload they share.
+static std::vector<uint32_t> plan_append_layout(const ParsedPack& P, const std::vector<Replacement>& reps,
+                                                const std::vector<int>& shared_with, const ImportOptions& opt) {
+    TraceScope trace("layout", "append");
+    std::vector<int64_t> slots = payload_slots(P);
+    std::vector<uint32_t> offsets(P.res_locs.size());
+    
+    struct Hole { uint64_t start, end; };
+    std::vector<Hole> holes;
+    std::vector<size_t> moved;
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        if (shared_with[i] >= 0) continue;
+        if (reps[i].file.empty() || (slots[i] >= 0 && reps[i].size <= (uint64_t)slots[i])) {
+            offsets[i] = rl.m_offset;
+            continue;
+        }
+        moved.push_back(i);
+        if (slots[i] >= 0) holes.push_back({ rl.m_offset, rl.m_offset + (uint64_t)slots[i] });
+    }
+    std::sort(holes.begin(), holes.end(), [](const Hole& a, const Hole& b) { return a.start < b.start; });
+    
+    uint64_t end = P.raw.size() - P.base();
+    size_t reused = 0;
+    for (size_t i : moved) {
+        uint64_t size = reps[i].size;
+        uint64_t at = UINT64_MAX;
+        for (size_t h = 0; opt.reuse_holes && h < holes.size(); ++h) {
+            uint64_t start = align_up(holes[h].start, opt.align);
+            if (start + size > holes[h].end) continue;
+            at = start;
+            holes[h].start = start + size;
+            reused++;
+            break;
+        }
+        if (at == UINT64_MAX) {
+            at = align_up(end, opt.align);
+            end = at + size;
+        }
+        if (at + size > UINT32_MAX)
+            throw std::runtime_error("Payload area too large for 32-bit offsets");
+        offsets[i] = (uint32_t)at;
+    }
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        if (shared_with[i] >= 0) offsets[i] = offsets[shared_with[i]];
+    }
+    
+    report("Append layout: %zu payloads kept in place, %zu moved (%zu into freed slots)\n",
+           P.res_locs.size() - moved.size(), moved.size(), reused);
+    return offsets;
+}
+
+// Points every tlresource_location at the new position of the bytes it
+// referenced. Offsets outside every resource (0 or special values) are kept.
+static void remap_tl_offsets(ParsedPack& P, const OffsetRemap& remap) {
+    TraceScope trace("tl_remap");
+    report("\nUpdating tlresource_location offsets...\n");
+    for_each_tl_vector(P, [&](const char* name, std::vector<tlresource_location>& vec) {
+        for (auto& tl : vec) {
+            uint32_t old = tl.offset;
+            tl.offset = remap.map(old);
+            if (old != tl.offset && vec.size() < 20) {
+                report("    %s: 0x%X -> 0x%X\n", name, old, tl.offset);
+            }
+        }
+    });
+}
+
+// Streams the rebuilt pack into out_path and returns its size. Only the header
+// and directory area is built in memory; payloads are copied in offset order
+// from the source pack or the replacement files by write_pack.
+static uint64_t rebuild_pack(const fs::path& orig_pack, const fs::path& input_dir,
+                             const fs::path& out_path, const fs::path& dict_path, const ImportOptions& opt) {
+    report("Parsing original pack %s...\n", orig_pack.string().c_str());
+    ParsedPack P = parse_pcpack(orig_pack);
+    
+    // Names are only needed to find the replacement files of this pack
+    std::vector<uint32_t> wanted = pack_name_hashes(P);
+    load_hash_dictionary(dict_path, &wanted);
+    
+    report("Original PCPACK base: 0x%X\n", P.base());
+    report("Processing %zu resources...\n", P.res_locs.size());
+    
+    // Where every payload comes from. Payload bytes are not loaded here: kept
+    // originals are copied from the mapping and replacements straight from disk.
+    std::vector<PayloadSource> payloads(P.res_locs.size());
+    std::vector<std::string> fnames;
+    std::vector<Replacement> reps = find_replacements(P, input_dir, opt.jobs, &fnames);
+    
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const char* fname = fnames[i].c_str();
+        
+        if (!reps[i].file.empty()) {
+            payloads[i].file = reps[i].file;
+            payloads[i].size = reps[i].size;
+            report("  [%zu] %s: from file (%u bytes)\n", i, fname, (uint32_t)reps[i].size);
+        } else {
+            // Keep original data
+            payloads[i] = kept_payload(P, i);
+            report("  [%zu] %s: %s (%u bytes)\n", i, fname,
+                   reps[i].unchanged ? "unchanged, kept original" : "kept original", P.res_locs[i].m_size);
+        }
+    }
+    
+    // Entries that share one stored payload with an earlier entry. Kept entries
+    // the source pack already aliased (same offset and size) always stay
+    // shared; --dedupe also merges any identical content.
+    SharedPayloads shared = find_shared_payloads(payloads, opt.dedupe);
+    
+    std::vector<uint32_t> new_offsets;
+    if (opt.layout == LAYOUT_APPEND) {
+        new_offsets = plan_append_layout(P, reps, shared.with, opt);
+    } else {
+        std::vector<LayoutItem> items(P.res_locs.size());
+        for (size_t i = 0; i < P.res_locs.size(); ++i)
+            items[i] = { (uint32_t)payloads[i].size, P.res_locs[i].field_0.m_type, P.res_locs[i].field_0.m_hash.source_hash_code };
+        LayoutPlan plan = plan_payload_layout(items, shared.with, opt.layout, opt.align, opt.small_align);
+        new_offsets = plan.offsets;
+        
+        if (opt.layout != LAYOUT_ORIGINAL || opt.small_align != 0) {
+            LayoutPlan ref = plan_payload_layout(items, shared.with, LAYOUT_ORIGINAL, opt.align, opt.align);
+            report("\nLayout %s: %llu bytes of padding, %lld saved against original order\n",
+                   layout_names[opt.layout], (unsigned long long)plan.padding,
+                   (long long)ref.padding - (long long)plan.padding);
+        }
+    }
+    if (shared.aliases || shared.merged)
+        report("\nShared payloads: %zu kept source aliases, %zu duplicates merged (%llu bytes)\n",
+               shared.aliases, shared.merged, (unsigned long long)shared.merged_bytes);
+    
+    // For tlresource_locations, find which resource they belong to and compute delta.
+    // Offsets outside every resource (0 or special values) are kept as they are.
+    OffsetRemap remap;
+    for (size_t i = 0; i < P.res_locs.size(); ++i)
+        remap.add(P.res_locs[i].m_offset, P.res_locs[i].m_size, new_offsets[i]);
+    remap.finish();
+    remap_tl_offsets(P, remap);
+    
+    // Kept payloads already point into the mapping, so the old ranges can go
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        P.res_locs[i].m_offset = new_offsets[i];
+        P.res_locs[i].m_size = (uint32_t)payloads[i].size;
+    }
+    
+    report("\nRebuilding PCPACK...\n");
+    WriteStats st = write_pack(out_path, P, payloads, shared.with);
+    report("Header area ends at 0x%llX, base is 0x%X\n", (unsigned long long)st.directory, P.base());
+    if (st.cloned || st.kernel_copied)
+        report("Payload copy: %llu bytes reflinked, %llu copied by the kernel, %llu written\n",
+               (unsigned long long)st.cloned, (unsigned long long)st.kernel_copied, (unsigned long long)st.written);
+    return st.size;
+}
+
+// Copies src to dst, as a copy-on-write clone where the filesystem supports it
+static void clone_file(const fs::path& src, const fs::path& dst) {
+#ifdef __linux__
+    int in = open(src.c_str(), O_RDONLY);
+    if (in >= 0) {
+        int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool cloned = out >= 0 && ioctl(out, FICLONE, in) == 0;
+        if (out >= 0) close(out);
+        close(in);
+        if (cloned) return;
+    }
+#endif
+    fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+}
+
+// Writes replacements over their original slots when every one of them fits,
+// leaving the layout and all other bytes alone. A slot runs up to the next
+// payload (or the end of the file), so alignment padding counts as room.
+// With the append layout, replacements that do not fit are written past the
+// end (or into vacated slots) and the directory is rewritten; the bytes they
+// left behind are no longer referenced.
+// Returns false without touching anything when the pack has to be rebuilt.
+static bool patch_pack_in_place(const fs::path& orig_pack, const fs::path& input_dir,
+                                const fs::path& out_path, const fs::path& dict_path, const ImportOptions& opt) {
+    TraceScope trace("patch_in_place", out_path.string());
+    report("Parsing original pack %s...\n", orig_pack.string().c_str());
+    ParsedPack P = parse_pcpack(orig_pack);
+    
+    std::vector<uint32_t> wanted = pack_name_hashes(P);
+    load_hash_dictionary(dict_path, &wanted);
+    
+    std::vector<int64_t> slots = payload_slots(P);
+    
+    struct Patch {
+        size_t index;
+        uint32_t new_offset;
+        uint32_t new_size;
+        fs::path file;
+    };
+    std::vector<Patch> patches;
+    std::vector<std::string> fnames;
+    std::vector<Replacement> reps = find_replacements(P, input_dir, opt.jobs, &fnames);
+    
+    std::vector<uint32_t> offsets;
+    if (opt.layout == LAYOUT_APPEND)
+        offsets = plan_append_layout(P, reps, std::vector<int>(P.res_locs.size(), -1), opt);
+    
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        if (reps[i].file.empty()) continue;
+        const char* fname = fnames[i].c_str();
+        uint64_t new_size = reps[i].size;
+        
+        if (opt.layout == LAYOUT_APPEND) {
+            patches.push_back({ i, offsets[i], (uint32_t)new_size, reps[i].file });
+            continue;
+        }
+        // Another resource sharing these bytes would change with this one
+        if (slots[i] < 0) {
+            report("  [%zu] %s: shares its bytes with another resource\n", i, fname);
+            return false;
+        }
+        if (new_size > (uint64_t)slots[i]) {
+            report("  [%zu] %s: %llu bytes do not fit in a %llu byte slot\n", i, fname,
+                   (unsigned long long)new_size, (unsigned long long)slots[i]);
+            return false;
+        }
+        patches.push_back({ i, rl.m_offset, (uint32_t)new_size, reps[i].file });
+    }
+    std::sort(patches.begin(), patches.end(), [](const Patch& a, const Patch& b) { return a.new_offset < b.new_offset; });
+    
+    // The directory is all we need from here on; drop the mapping so the
+    // pack itself can be opened for writing.
+    uint64_t file_end = P.raw.size();
+    P.raw = MappedFile();
+    
+    std::error_code ec;
+    if (!fs::equivalent(orig_pack, out_path, ec))
+        clone_file(orig_pack, out_path);
+    
+    std::fstream f(out_path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!f) throw std::runtime_error("Cannot write: " + out_path.string());
+    
+    std::vector<char> buf(1 << 20);
+    auto write_zeros = [&](uint64_t size) {
+        std::fill(buf.begin(), buf.end(), 0);
+        while (size > 0) {
+            size_t n = (size_t)std::min<uint64_t>(size, buf.size());
+            f.write(buf.data(), n);
+            size -= n;
+        }
+    };
+    
+    size_t moved = std::count_if(patches.begin(), patches.end(), [&](const Patch& pt) {
+        return pt.new_offset != P.res_locs[pt.index].m_offset;
+    });
+    
+    uint64_t written = 0;
+    {
+        TraceScope payloads_trace("write_payloads");
+        for (const auto& pt : patches) {
+            auto& rl = P.res_locs[pt.index];
+            uint64_t start = (uint64_t)P.base() + pt.new_offset;
+            if (start > file_end) {
+                f.seekp((std::streamoff)file_end);
+                write_zeros(start - file_end);
+            } else {
+                f.seekp((std::streamoff)start);
+            }
+            copy_from_file(f, pt.file, pt.new_size, buf);
+            file_end = std::max(file_end, start + pt.new_size);
+            
+            if (pt.new_offset != rl.m_offset) {
+                written += pt.new_size;
+                report("  [%zu] moved %u bytes from 0x%X to 0x%X\n", pt.index, pt.new_size, rl.m_offset, pt.new_offset);
+            } else {
+                // Clear what is left of the old payload, like the padding of a rebuild
+                if (pt.new_size < rl.m_size) write_zeros(rl.m_size - pt.new_size);
+                written += std::max(pt.new_size, rl.m_size);
+                report("  [%zu] patched %u bytes at 0x%X\n", pt.index, pt.new_size, rl.m_offset);
+            }
+            
+            if (pt.new_size != rl.m_size && moved == 0) {
+                f.seekp((std::streamoff)(P.res_locs_pos + pt.index * sizeof(resource_location)
+                                         + offsetof(resource_location, m_size)));
+                f.write((const char*)&pt.new_size, sizeof(pt.new_size));
+            }
+        }
+    }
+    
+    // Moved payloads change offsets all over the directory; write it whole
+    if (moved > 0) {
+        std::vector<uint32_t> new_offset(P.res_locs.size());
+        for (size_t i = 0; i < P.res_locs.size(); ++i) new_offset[i] = P.res_locs[i].m_offset;
+        for (const auto& pt : patches) new_offset[pt.index] = pt.new_offset;
+        
+        OffsetRemap remap;
+        for (size_t i = 0; i < P.res_locs.size(); ++i)
+            remap.add(P.res_locs[i].m_offset, P.res_locs[i].m_size, new_offset[i]);
+        remap.finish();
+        remap_tl_offsets(P, remap);
+        for (const auto& pt : patches) {
+            P.res_locs[pt.index].m_offset = pt.new_offset;
+            P.res_locs[pt.index].m_size = pt.new_size;
+        }
+        std::vector<uint8_t> dir = serialize_directory(P);
+        if (dir.size() != P.base())
+            throw std::runtime_error("Directory no longer fits below base");
+        f.seekp(0);
+        f.write((const char*)dir.data(), dir.size());
+        written += dir.size();
+    }
+    
+    {
+        TraceScope close_trace("close");
+        f.close();
+    }
+    if (!f) throw std::runtime_error("Write failed: " + out_path.string());
+    
+    report("\nIn-place patch complete!\n");
+    report("  Output: %s\n", out_path.string().c_str());
+    report("  Patched: %zu resources (%zu moved), %llu bytes written\n",
+           patches.size(), moved, (unsigned long long)written);
+    return true;
+}
+
+static void do_import(const fs::path& orig_pack, const fs::path& input_dir,
+                      const fs::path& out_pack, const fs::path& dict_path, const ImportOptions& opt) {
+    TraceScope trace("import", orig_pack.string());
+    fs::path out_path = out_pack.empty() ?
+        (orig_pack.parent_path() / (orig_pack.stem().string() + ".NEW.PCPACK")) : out_pack;
+    if (!out_path.parent_path().empty())
+        fs::create_directories(out_path.parent_path());
+    
+    if (opt.in_place) {
+        if (patch_pack_in_place(orig_pack, input_dir, out_path, dict_path, opt))
+            return;
+        report("Replacements do not fit in place, rebuilding instead\n\n");
+    }
+    
+    // Write next to the final name and rename at the end: the source stays
+    // mapped while payloads are copied, even when rebuilding a pack over itself.
+    fs::path tmp_path = out_path;
+    tmp_path += ".tmp";
+    uint64_t out_size = 0;
+    try {
+        out_size = rebuild_pack(orig_pack, input_dir, tmp_path, dict_path, opt);
+    } catch (...) {
+        std::error_code ec;
+        fs::remove(tmp_path, ec);
+        throw;
+    }
+    fs::rename(tmp_path, out_path);
+    
+    report("\nImport complete!\n");
+    report("  Output: %s\n", out_path.string().c_str());
+    report("  Size: %llu bytes (0x%llX)\n", (unsigned long long)out_size, (unsigned long long)out_size);
+}
+
+// Folder sync: files of known resources replace them, files with new keys add
+// resources (and TL entries), resources without a file are kept. Entries are
+// sorted by type then hash and the directory size, and with it base, follows.
+// Unlike import, every file in the folder counts, named or not.
+static void do_reimport(const fs::path& orig_pack, const fs::path& folder,
+                        const fs::path& out_pack, const fs::path& dict_path, const ImportOptions& opt) {
+    TraceScope trace("reimport", orig_pack.string());
+    fs::path out_path = out_pack.empty() ?
+        (orig_pack.parent_path() / (orig_pack.stem().string() + ".NEW.PCPACK")) : out_pack;
+    if (!out_path.parent_path().empty())
+        fs::create_directories(out_path.parent_path());
+    
+    report("Parsing original pack %s...\n", orig_pack.string().c_str());
+    ParsedPack P = parse_pcpack(orig_pack);
+    
+    // File names hash like the game does; the dictionary only adds the few
+    // names whose entry is under another hash
+    load_hash_dictionary(dict_path);
+    std::unordered_map<std::string, uint32_t> exceptions = name_hash_exceptions(g_hashDict);
+    
+    LayoutOptions lay;
+    lay.layout = opt.layout;
+    lay.align = opt.align;
+    lay.small_align = opt.small_align;
+    
+    fs::path tmp_path = out_path;
+    tmp_path += ".tmp";
+    WriteStats st;
+    try {
+        ReimportResult r = plan_reimport(P, folder, exceptions, lay, opt.dedupe);
+        report("Updated: %zu, unchanged: %zu, added: %zu, skipped: %zu\n",
+               r.updated, r.unchanged, r.added, r.skipped);
+        if (opt.layout != LAYOUT_ORIGINAL || opt.small_align != 0)
+            report("Layout %s: %llu bytes of padding, %lld saved against original order\n",
+                   layout_names[opt.layout], (unsigned long long)r.padding,
+                   (long long)r.original_padding - (long long)r.padding);
+        if (r.shared.aliases || r.shared.merged)
+            report("Shared payloads: %zu kept source aliases, %zu duplicates merged (%llu bytes)\n",
+                   r.shared.aliases, r.shared.merged, (unsigned long long)r.shared.merged_bytes);
+        st = write_pack(tmp_path, P, r.payloads, r.shared.with);
+    } catch (...) {
+        std::error_code ec;
+        fs::remove(tmp_path, ec);
+        throw;
+    }
+    fs::rename(tmp_path, out_path);
+    
+    report("\nReimport complete!\n");
+    report("  Output: %s\n", out_path.string().c_str());
+    report("  Resources: %zu, base 0x%X\n", P.res_locs.size(), P.base());
+    report("  Size: %llu bytes (0x%llX)\n", (unsigned long long)st.size, (unsigned long long)st.size);
+}
+
+// ==================== Delta Patch ====================
+// A patch rebuilds the new pack front to back from three kinds of segments:
+// COPY a byte range of the old pack, DATA stored in the patch, or ZERO fill.
+// Payloads found in the old pack (at the position that continues the previous
+// copy, under the same key, or anywhere with the same content) become COPY
+// segments, so a patch holds the new directory plus what actually changed.
+//
+//   patch_file_header
+//   repeated: uint8_t op, then
+//     COPY: uint64_t old_offset, uint64_t size, uint64_t xxh64 of those old bytes
+//     DATA: uint64_t size, bytes
+//     ZERO: uint64_t size
+//   uint8_t PATCH_END
+
+struct patch_file_header {
+    char     magic[4];          // "PCPD"
+    uint32_t version;
+    uint64_t old_size;
+    uint64_t old_head_digest;   // XXH64 of the old pack below its base
+    uint64_t new_size;
+};
+static_assert(sizeof(patch_file_header) == 0x20, "");
+
+static const uint32_t PATCH_FILE_VERSION = 1;
+
+enum PatchOp : uint8_t { PATCH_END = 0, PATCH_COPY = 1, PATCH_DATA = 2, PATCH_ZERO = 3 };
+
+// XXH64 of everything below the payloads, which identifies a pack version
+static uint64_t pack_head_digest(const MappedFile& f) {
+    resource_pack_header h{};
+    if (f.size() >= sizeof(h)) memcpy(&h, f.data(), sizeof(h));
+    return xxh64(f.data(), std::min<size_t>(h.res_dir_mash_size, f.size()));
+}
+
+static void diffpatch_create(const fs::path& old_path, const fs::path& new_path, const fs::path& patch_path) {
+    TraceScope trace("diffpatch_create", patch_path.string());
+    ParsedPack O = parse_pcpack(old_path);
+    ParsedPack N = parse_pcpack(new_path);
+    const uint8_t* od = O.raw.data();
+    const uint8_t* nd = N.raw.data();
+    
+    // Old payloads by content, for resources that were renamed or moved between keys
+    std::unordered_map<uint64_t, uint64_t> old_by_digest;
+    for (const auto& rl : O.res_locs) {
+        uint64_t start = (uint64_t)O.base() + rl.m_offset;
+        if (rl.m_size == 0 || start + rl.m_size > O.raw.size()) continue;
+        old_by_digest.emplace(xxh64(od + start, rl.m_size) ^ ((uint64_t)rl.m_size * Xxh64::P1), start);
+    }
+    
+    struct Segment { PatchOp op; uint64_t new_start, size, old_start; };
+    std::vector<Segment> segs;
+    
+    auto emit = [&](PatchOp op, uint64_t new_start, uint64_t size, uint64_t old_start) {
+        if (size == 0) return;
+        if (!segs.empty()) {
+            Segment& last = segs.back();
+            bool follows = last.op == op && last.new_start + last.size == new_start;
+            if (follows && (op != PATCH_COPY || last.old_start + last.size == old_start)) {
+                last.size += size;
+                return;
+            }
+        }
+        segs.push_back({ op, new_start, size, old_start });
+    };
+    
+    auto same_at = [&](uint64_t old_start, uint64_t new_start, uint64_t size) {
+        return old_start + size <= O.raw.size() && memcmp(od + old_start, nd + new_start, size) == 0;
+    };
+    
+    // Describes new bytes [start, start + size); `key_match` is where the
+    // old pack holds the same resource, if anywhere
+    auto cover = [&](uint64_t start, uint64_t size, int64_t key_match) {
+        if (size == 0) return;
+        if (!segs.empty() && segs.back().op == PATCH_COPY) {
+            uint64_t cont = segs.back().old_start + (start - segs.back().new_start);
+            if (same_at(cont, start, size)) { emit(PATCH_COPY, start, size, cont); return; }
+        }
+        if (key_match >= 0 && same_at((uint64_t)key_match, start, size)) {
+            emit(PATCH_COPY, start, size, (uint64_t)key_match);
+            return;
+        }
+        auto it = old_by_digest.find(xxh64(nd + start, size) ^ (size * Xxh64::P1));
+        if (it != old_by_digest.end() && same_at(it->second, start, size)) {
+            emit(PATCH_COPY, start, size, it->second);
+            return;
+        }
+        bool zero = std::all_of(nd + start, nd + start + size, [](uint8_t b) { return b == 0; });
+        emit(zero ? PATCH_ZERO : PATCH_DATA, start, size, 0);
+    };
+    
+    // Header and directory, then payloads and the gaps between them in file order
+    uint64_t pos = std::min<uint64_t>(N.base(), N.raw.size());
+    cover(0, pos, 0);
+    
+    std::vector<size_t> order(N.res_locs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return N.res_locs[a].m_offset < N.res_locs[b].m_offset;
+    });
+    for (size_t i : order) {
+        const auto& rl = N.res_locs[i];
+        uint64_t start = (uint64_t)N.base() + rl.m_offset;
+        uint64_t end = std::min<uint64_t>(start + rl.m_size, N.raw.size());
+        if (end <= pos) continue;   // aliased or out of bounds
+        if (start > pos) cover(pos, start - pos, -1);
+        start = std::max(start, pos);
+        
+        int64_t key_match = -1;
+        int j = O.find(rl.field_0.m_hash.source_hash_code, rl.field_0.m_type);
+        if (j >= 0) key_match = (int64_t)O.base() + O.res_locs[j].m_offset + (start - ((uint64_t)N.base() + rl.m_offset));
+        cover(start, end - start, key_match);
+        pos = end;
+    }
+    cover(pos, N.raw.size() - pos, -1);
+    
+    // Write the patch
+    patch_file_header hdr{};
+    memcpy(hdr.magic, "PCPD", 4);
+    hdr.version = PATCH_FILE_VERSION;
+    hdr.old_size = O.raw.size();
+    hdr.old_head_digest = pack_head_digest(O.raw);
+    hdr.new_size = N.raw.size();
+    
+    std::ofstream of(patch_path, std::ios::binary);
+    if (!of) throw std::runtime_error("Cannot write: " + patch_path.string());
+    of.write((const char*)&hdr, sizeof(hdr));
+    
+    uint64_t copied = 0, stored = 0, zeroed = 0;
+    for (const auto& sg : segs) {
+        uint8_t op = sg.op;
+        of.write((const char*)&op, 1);
+        if (sg.op == PATCH_COPY) {
+            uint64_t digest = xxh64(od + sg.old_start, sg.size);
+            of.write((const char*)&sg.old_start, 8);
+            of.write((const char*)&sg.size, 8);
+            of.write((const char*)&digest, 8);
+            copied += sg.size;
+        } else {
+            of.write((const char*)&sg.size, 8);
+            if (sg.op == PATCH_DATA) {
+                of.write((const char*)nd + sg.new_start, sg.size);
+                stored += sg.size;
+            } else {
+                zeroed += sg.size;
+            }
+        }
+    }
+    uint8_t end_op = PATCH_END;
+    of.write((const char*)&end_op, 1);
+    uint64_t patch_size = (uint64_t)of.tellp();
+    of.close();
+    if (!of) throw std::runtime_error("Write failed: " + patch_path.string());
+    
+    printf("Patch written to %s\n", patch_path.string().c_str());
+    printf("  Segments: %zu\n", segs.size());
+    printf("  Copied from old pack: %llu bytes\n", (unsigned long long)copied);
+    printf("  Stored in patch: %llu bytes\n", (unsigned long long)stored);
+    printf("  Zero fill: %llu bytes\n", (unsigned long long)zeroed);
+    printf("  Patch size: %llu bytes\n", (unsigned long long)patch_size);
+}
+
+// Streams the new pack out of the old one and the patch; neither is loaded
+// into memory. Writes next to out_path and renames at the end, so out_path
+// may be the old pack itself.
+static void diffpatch_apply(const fs::path& old_path, const fs::path& patch_path, const fs::path& out_path) {
+    TraceScope trace("diffpatch_apply", out_path.string());
+    std::ifstream pf(patch_path, std::ios::binary);
+    if (!pf) throw std::runtime_error("Cannot open: " + patch_path.string());
+    patch_file_header hdr{};
+    if (!pf.read((char*)&hdr, sizeof(hdr)) || memcmp(hdr.magic, "PCPD", 4) != 0)
+        throw std::runtime_error("Not a PCPACK patch: " + patch_path.string());
+    if (hdr.version != PATCH_FILE_VERSION)
+        throw std::runtime_error("Unsupported patch version");
+    
+    fs::path tmp_path = out_path;
+    tmp_path += ".tmp";
+    uint64_t out_size = 0;
+    try {
+        MappedFile old_file(old_path);
+        if (old_file.size() != hdr.old_size || pack_head_digest(old_file) != hdr.old_head_digest)
+            throw std::runtime_error("Patch was made for a different version of " + old_path.string());
+        
+        std::ofstream of(tmp_path, std::ios::binary);
+        if (!of) throw std::runtime_error("Cannot write: " + tmp_path.string());
+        
+        auto read_u64 = [&]() {
+            uint64_t v;
+            if (!pf.read((char*)&v, 8)) throw std::runtime_error("Truncated patch");
+            return v;
+        };
+        
+        std::vector<char> buf(1 << 20);
+        for (;;) {
+            uint8_t op;
+            if (!pf.read((char*)&op, 1)) throw std::runtime_error("Truncated patch");
+            if (op == PATCH_END) break;
+            
+            if (op == PATCH_COPY) {
+                uint64_t start = read_u64(), size = read_u64(), digest = read_u64();
+                if (start + size > old_file.size() || start + size < start)
+                    throw std::runtime_error("Patch copies past the end of the old pack");
+                if (xxh64(&old_file[(size_t)start], (size_t)size) != digest)
+                    throw std::runtime_error("Old pack content differs from what the patch expects");
+                of.write((const char*)&old_file[(size_t)start], (std::streamsize)size);
+                out_size += size;
+            } else if (op == PATCH_DATA || op == PATCH_ZERO) {
+                uint64_t size = read_u64();
+                if (op == PATCH_ZERO) std::fill(buf.begin(), buf.end(), 0);
+                for (uint64_t left = size; left > 0; ) {
+                    size_t n = (size_t)std::min<uint64_t>(left, buf.size());
+                    if (op == PATCH_DATA && !pf.read(buf.data(), n)) throw std::runtime_error("Truncated patch");
+                    of.write(buf.data(), n);
+                    left -= n;
+                }
+                out_size += size;
+            } else {
+                throw std::runtime_error("Corrupted patch: unknown segment");
+            }
+        }
+        if (out_size != hdr.new_size)
+            throw std::runtime_error("Corrupted patch: output size mismatch");
+        of.close();
+        if (!of) throw std::runtime_error("Write failed: " + tmp_path.string());
+    } catch (...) {
+        std::error_code ec;
+        fs::remove(tmp_path, ec);
+        throw;
+    }
+    fs::rename(tmp_path, out_path);
+    
+    printf("Patched pack written to %s (%llu bytes)\n", out_path.string().c_str(), (unsigned long long)out_size);
+}
+
+// ==================== Catalog ====================
+// Where every resource of a game install lives, answered without opening a
+// pack. `catalog build` reads only the directories of the packs under a
+// folder and writes one table sorted by key; building again reuses the
+// entries of packs whose size and modification time did not change.
+// `catalog find` maps the table and binary searches it.
+//
+//   catalog_file_header
+//   catalog_pack  packs[pack_count]      sorted by path
+//   catalog_entry entries[entry_count]   sorted by hash, type, then pack
+//   char          blob[blob_size]        root folder, then the pack paths
+//                                        relative to it, NUL-terminated
+
+struct catalog_file_header {
+    char     magic[4];      // "PCCT"
+    uint32_t version;
+    uint32_t pack_count;
+    uint32_t entry_count;
+    uint32_t blob_size;
+    uint32_t reserved;
+};
+static_assert(sizeof(catalog_file_header) == 0x18, "");
+
+struct catalog_pack {
+    uint64_t size;
+    int64_t  mtime;         // file clock ticks, only compared for equality
+    uint32_t path;          // blob offset
+    uint32_t resources;
+    uint32_t flags;         // CATALOG_*
+    uint32_t reserved;
+};
+static_assert(sizeof(catalog_pack) == 0x20, "");
+
+struct catalog_entry {
+    uint32_t hash;
+    uint32_t type;
+    uint32_t pack;
+    uint32_t size;
+    uint64_t offset;        // payload position in the pack file
+    uint64_t digest;        // XXH64 of the payload, 0 unless built with --digests
+};
+static_assert(sizeof(catalog_entry) == 0x20, "");
+
+static const uint32_t CATALOG_FILE_VERSION = 1;
+
+enum : uint32_t {
+    CATALOG_DIGESTS    = 1,  // entries of this pack carry payload digests
+    CATALOG_UNREADABLE = 2,  // directory could not be parsed; no entries
 };
-static_assert(sizeof(resource_versions) == 0x14, "");
-
-struct resource_pack_header {
-    resource_versions field_0;      // 0x00-0x13
-    uint32_t          field_14;     // 0x14
-    uint32_t          directory_offset;  // 0x18 - typically 0x30
-    uint32_t          res_dir_mash_size; // 0x1C - base offset where payloads start (0x1020)
-    uint32_t          field_20;     // 0x20
-    uint32_t          field_24;     // 0x24
-    uint32_t          field_28;     // 0x28
+
+static bool catalog_key_less(const catalog_entry& a, const catalog_entry& b) {
+    if (a.hash != b.hash) return a.hash < b.hash;
+    if (a.type != b.type) return a.type < b.type;
+    return a.pack < b.pack;
+}
+
+// A catalog used straight from its mapping, like a compiled dictionary
+struct Catalog {
+    MappedFile map;
+    const catalog_pack*  packs = nullptr;
+    const catalog_entry* entries = nullptr;
+    const char*          blob = nullptr;
+    size_t pack_count = 0;
+    size_t entry_count = 0;
+    size_t blob_size = 0;
+    
+    const char* root() const { return blob; }
+    const char* pack_path(uint32_t id) const { return blob + packs[id].path; }
+    
+    // Entries for hash, of one type or of every type when type < 0
+    std::pair<const catalog_entry*, const catalog_entry*> find(uint32_t hash, int type) const {
+        catalog_entry lo{}, hi{};
+        lo.hash = hi.hash = hash;
+        lo.type = type < 0 ? 0 : (uint32_t)type;
+        hi.type = type < 0 ? UINT32_MAX : (uint32_t)type;
+        hi.pack = UINT32_MAX;
+        const catalog_entry* end = entries + entry_count;
+        const catalog_entry* first = std::lower_bound(entries, end, lo, catalog_key_less);
+        const catalog_entry* last = std::upper_bound(first, end, hi, catalog_key_less);
+        return { first, last };
+    }
+};
+
+// Leaves out untouched unless the whole catalog is valid
+static void load_catalog(Catalog& out, const fs::path& path) {
+    Catalog C;
+    C.map = MappedFile(path);
+    catalog_file_header h;
+    if (C.map.size() < sizeof(h)) throw std::runtime_error("Invalid catalog: " + path.string());
+    memcpy(&h, C.map.data(), sizeof(h));
+    uint64_t need = sizeof(h) + (uint64_t)h.pack_count * sizeof(catalog_pack)
+                  + (uint64_t)h.entry_count * sizeof(catalog_entry) + h.blob_size;
+    if (memcmp(h.magic, "PCCT", 4) != 0 || h.version != CATALOG_FILE_VERSION || need > C.map.size() || h.blob_size == 0)
+        throw std::runtime_error("Invalid catalog: " + path.string());
+    C.packs   = (const catalog_pack*)(C.map.data() + sizeof(h));
+    C.entries = (const catalog_entry*)(C.packs + h.pack_count);
+    C.blob    = (const char*)(C.entries + h.entry_count);
+    C.pack_count = h.pack_count;
+    C.entry_count = h.entry_count;
+    C.blob_size = h.blob_size;
+    if (C.blob[h.blob_size - 1] != '\0')
+        throw std::runtime_error("Invalid catalog: " + path.string());
+    for (size_t i = 0; i < C.pack_count; ++i) {
+        if (C.packs[i].path >= h.blob_size) throw std::runtime_error("Invalid catalog: " + path.string());
+    }
+    for (size_t i = 0; i < C.entry_count; ++i) {
+        if (C.entries[i].pack >= C.pack_count) throw std::runtime_error("Invalid catalog: " + path.string());
+    }
+    out = std::move(C);
+}
+
+struct CatalogStats {
+    size_t packs = 0;
+    size_t scanned = 0;      // directories read by this build
+    size_t reused = 0;       // unchanged packs taken from the previous catalog
+    size_t removed = 0;      // packs of the previous catalog that are gone
+    size_t unreadable = 0;
+    size_t entries = 0;
+    uint64_t bytes = 0;      // catalog file size
+};
+
+// Scans root for *.PCPACK (recursively) and writes the catalog to cat_path.
+// An existing catalog for the same root provides the entries of unchanged
+// packs. With digests every payload is read and hashed, which costs a full
+// read of each new or changed pack.
+static CatalogStats catalog_build(const fs::path& root, const fs::path& cat_path, unsigned jobs, bool digests) {
+    TraceScope trace("catalog_build", root.string());
+    const std::string root_str = fs::absolute(root).lexically_normal().generic_string();
+    
+    struct PackFile { std::string rel; uint64_t size; int64_t mtime; };
+    std::vector<PackFile> files;
+    for (const auto& de : fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied)) {
+        if (!de.is_regular_file()) continue;
+        std::string ext = de.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::toupper);
+        if (ext != ".PCPACK") continue;
+        files.push_back({ de.path().lexically_relative(root).generic_string(), (uint64_t)de.file_size(),
+                          (int64_t)de.last_write_time().time_since_epoch().count() });
+    }
+    std::sort(files.begin(), files.end(), [](const PackFile& a, const PackFile& b) { return a.rel < b.rel; });
+    
+    // Previous catalog of the same folder; anything wrong with it means a full build
+    Catalog old;
+    bool have_old = false;
+    std::error_code ec;
+    if (fs::exists(cat_path, ec)) {
+        try {
+            load_catalog(old, cat_path);
+            have_old = root_str == old.root();
+        } catch (const std::exception& e) {
+            report("Ignoring previous catalog: %s\n", e.what());
+        }
+        if (!have_old) old = Catalog();
+    }
+    std::unordered_map<std::string, uint32_t> old_ids;
+    if (have_old) {
+        for (uint32_t i = 0; i < (uint32_t)old.pack_count; ++i) old_ids.emplace(old.pack_path(i), i);
+    }
+    
+    CatalogStats st;
+    st.packs = files.size();
+    std::vector<catalog_pack> packs(files.size());
+    std::vector<int64_t> new_id_of_old(have_old ? old.pack_count : 0, -1);
+    std::vector<size_t> scan;
+    size_t still_there = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        packs[i].size = files[i].size;
+        packs[i].mtime = files[i].mtime;
+        auto it = old_ids.find(files[i].rel);
+        if (it != old_ids.end()) {
+            ++still_there;
+            const catalog_pack& op = old.packs[it->second];
+            if (op.size == files[i].size && op.mtime == files[i].mtime && (!digests || (op.flags & CATALOG_DIGESTS))) {
+                packs[i].resources = op.resources;
+                packs[i].flags = op.flags;
+                new_id_of_old[it->second] = (int64_t)i;
+                ++st.reused;
+                continue;
+            }
+        }
+        scan.push_back(i);
+    }
+    st.removed = old.pack_count - still_there;
+    
+    // Directories of new and changed packs, one pack per thread
+    std::vector<std::vector<catalog_entry>> scanned(scan.size());
+    std::vector<std::string> errors(scan.size());
+    parallel_for(scan.size(), jobs, [&](size_t s) {
+        const uint32_t id = (uint32_t)scan[s];
+        const fs::path path = root / fs::path(files[id].rel);
+        try {
+            ParsedPack P = digests ? parse_pcpack(path) : read_pack_directory(path);
+            auto& out = scanned[s];
+            out.resize(P.res_locs.size());
+            for (size_t i = 0; i < P.res_locs.size(); ++i) {
+                const auto& rl = P.res_locs[i];
+                catalog_entry& e = out[i];
+                e.hash = rl.field_0.m_hash.source_hash_code;
+                e.type = rl.field_0.m_type;
+                e.pack = id;
+                e.size = rl.m_size;
+                e.offset = (uint64_t)P.base() + rl.m_offset;
+                e.digest = 0;
+                if (digests) {
+                    ByteSpan b = P.payload(i);
+                    e.digest = xxh64(b.data, b.size);
+                }
+            }
+            packs[id].resources = (uint32_t)out.size();
+            packs[id].flags = digests ? (uint32_t)CATALOG_DIGESTS : 0;
+        } catch (const std::exception& e) {
+            scanned[s].clear();
+            packs[id].resources = 0;
+            packs[id].flags = CATALOG_UNREADABLE;
+            errors[s] = e.what();
+        }
+    }, "catalog_scan");
+    st.scanned = scan.size();
+    for (size_t s = 0; s < scan.size(); ++s) {
+        if (!errors[s].empty()) fprintf(stderr, "Warning: %s: %s\n", files[scan[s]].rel.c_str(), errors[s].c_str());
+    }
+    for (const auto& p : packs) {
+        if (p.flags & CATALOG_UNREADABLE) ++st.unreadable;
+    }
+    
+    // Kept entries are still in key order (pack ids of both catalogs follow the
+    // path order); the new ones are sorted and the two runs merged
+    std::vector<catalog_entry> kept;
+    for (size_t i = 0; i < old.entry_count; ++i) {
+        catalog_entry e = old.entries[i];
+        if (new_id_of_old[e.pack] < 0) continue;
+        e.pack = (uint32_t)new_id_of_old[e.pack];
+        kept.push_back(e);
+    }
+    std::vector<catalog_entry> fresh;
+    for (auto& v : scanned) fresh.insert(fresh.end(), v.begin(), v.end());
+    std::sort(fresh.begin(), fresh.end(), catalog_key_less);
+    std::vector<catalog_entry> entries(kept.size() + fresh.size());
+    std::merge(kept.begin(), kept.end(), fresh.begin(), fresh.end(), entries.begin(), catalog_key_less);
+    st.entries = entries.size();
+    
+    std::vector<char> blob(root_str.begin(), root_str.end());
+    blob.push_back('\0');
+    for (size_t i = 0; i < files.size(); ++i) {
+        packs[i].path = (uint32_t)blob.size();
+        blob.insert(blob.end(), files[i].rel.begin(), files[i].rel.end());
+        blob.push_back('\0');
+    }
+    
+    catalog_file_header hdr{};
+    memcpy(hdr.magic, "PCCT", 4);
+    hdr.version = CATALOG_FILE_VERSION;
+    hdr.pack_count = (uint32_t)packs.size();
+    hdr.entry_count = (uint32_t)entries.size();
+    hdr.blob_size = (uint32_t)blob.size();
+    
+    // The old catalog may still be mapped; write next to it and rename
+    old = Catalog();
+    fs::path tmp_path = cat_path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream of(tmp_path, std::ios::binary);
+        if (!of) throw std::runtime_error("Cannot write: " + tmp_path.string());
+        of.write((const char*)&hdr, sizeof(hdr));
+        of.write((const char*)packs.data(), packs.size() * sizeof(catalog_pack));
+        of.write((const char*)entries.data(), entries.size() * sizeof(catalog_entry));
+        of.write(blob.data(), blob.size());
+        st.bytes = (uint64_t)of.tellp();
+        of.close();
+        if (!of) {
+            fs::remove(tmp_path, ec);
+            throw std::runtime_error("Write failed: " + tmp_path.string());
+        }
+    }
+    fs::rename(tmp_path, cat_path);
+    
+    report("Catalog written to %s\n", cat_path.string().c_str());
+    report("  Packs: %zu (%zu scanned, %zu unchanged, %zu removed, %zu unreadable)\n",
+           st.packs, st.scanned, st.reused, st.removed, st.unreadable);
+    report("  Resources: %zu\n", st.entries);
+    report("  Catalog size: %llu bytes\n", (unsigned long long)st.bytes);
+    return st;
+}
+
+// Prints where each key is found. Returns how many keys were not found.
+static size_t catalog_find(const fs::path& cat_path, const std::vector<std::string>& keys) {
+    Catalog C;
+    load_catalog(C, cat_path);
+    
+    size_t missing = 0, hits = 0;
+    double lookup_seconds = 0;
+    for (const auto& key : keys) {
+        const ResourceKey k = parse_resource_key(key);
+        auto t0 = std::chrono::steady_clock::now();
+        auto range = C.find(k.hash, k.type);
+        lookup_seconds += seconds_since(t0);
+        if (range.first == range.second) {
+            fprintf(stderr, "Not found: %s\n", key.c_str());
+            ++missing;
+            continue;
+        }
+        for (const catalog_entry* e = range.first; e != range.second; ++e, ++hits) {
+            char name[16];
+            snprintf(name, sizeof(name), "0x%08X", e->hash);
+            printf("%s%s  %s/%s  offset 0x%08llX  size %u", k.by_hash ? name : k.name.c_str(), get_ext(e->type),
+                   C.root(), C.pack_path(e->pack), (unsigned long long)e->offset, e->size);
+            if (C.packs[e->pack].flags & CATALOG_DIGESTS) printf("  xxh64 %016llx", (unsigned long long)e->digest);
+            printf("\n");
+        }
+    }
+    fflush(stdout);
+    fprintf(stderr, "%zu hits for %zu keys in %zu packs (lookups took %.1f us)\n",
+            hits, keys.size(), C.pack_count, lookup_seconds * 1e6);
+    return missing;
+}
+
+// ==================== Mount ====================
+// A pack as a read-only directory through FUSE: one file per resource, named
+// as export names them, plus _manifest.txt. Mounting parses the directory
+// only; reads are copied out of the pack mapping, so only the pages of the
+// resources that are read ever come from disk. The manifest holds payload
+// digests, which are computed the first time it is opened; its size is known
+// before that because every digest has the same width.
+
+#ifdef PCPACK_WITH_FUSE
+
+struct MountedPack {
+    ParsedPack P;
+    struct stat pack_stat{};
+    std::vector<size_t> files;                         // resource per file, in index order
+    std::unordered_map<std::string, size_t> by_name;   // file name -> resource
+    std::vector<std::string> names;                    // file name of every resource
+    std::string manifest;
+    std::vector<std::pair<size_t, size_t>> digest_at;  // resource, manifest position of its digest
+    std::once_flag digests_once;
 };
-static_assert(sizeof(resource_pack_header) == 0x2C, "");
-
-struct generic_mash_header {
-    int32_t safety_key;   // 0x00
-    int32_t field_4;      // 0x04
-    int32_t field_8;      // 0x08 - total size of mash data
-    int16_t class_id;     // 0x0C
-    int16_t field_E;      // 0x0E
+
+static MountedPack g_mount;
+
+static const uint64_t MOUNT_MANIFEST = UINT64_MAX;   // fuse_file_info::fh of _manifest.txt
+
+static void mount_fill_digests() {
+    std::call_once(g_mount.digests_once, [] {
+        MountedPack& M = g_mount;
+        char digest[17];
+        for (const auto& d : M.digest_at) {
+            ByteSpan b = M.P.payload(d.first);
+            snprintf(digest, sizeof(digest), "%016llx", (unsigned long long)xxh64(b.data, b.size));
+            memcpy(&M.manifest[d.second], digest, 16);
+        }
+    });
+}
+
+static void mount_file_stat(struct stat* st, uint64_t size) {
+    const struct stat& ps = g_mount.pack_stat;
+    st->st_mode = S_IFREG | 0444;
+    st->st_nlink = 1;
+    st->st_size = (off_t)size;
+    st->st_uid = ps.st_uid;
+    st->st_gid = ps.st_gid;
+    st->st_mtime = ps.st_mtime;
+    st->st_ctime = ps.st_ctime;
+    st->st_atime = ps.st_atime;
+}
+
+static void* mount_init(struct fuse_conn_info*, struct fuse_config* cfg) {
+    // The pack cannot change under the mount, so the kernel may cache pages
+    // and attributes for as long as it likes
+    cfg->kernel_cache = 1;
+    cfg->entry_timeout = cfg->attr_timeout = 3600.0;
+    cfg->negative_timeout = 3600.0;
+    return nullptr;
+}
+
+static int mount_getattr(const char* path, struct stat* st, struct fuse_file_info*) {
+    memset(st, 0, sizeof(*st));
+    if (strcmp(path, "/") == 0) {
+        mount_file_stat(st, 0);
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2;
+        return 0;
+    }
+    if (strcmp(path, "/_manifest.txt") == 0) {
+        mount_file_stat(st, g_mount.manifest.size());
+        return 0;
+    }
+    auto it = g_mount.by_name.find(path + 1);
+    if (it == g_mount.by_name.end()) return -ENOENT;
+    mount_file_stat(st, g_mount.P.res_locs[it->second].m_size);
+    return 0;
+}
+
+static int mount_readdir(const char* path, void* buf, fuse_fill_dir_t filler, off_t, struct fuse_file_info*,
+                         enum fuse_readdir_flags) {
+    if (strcmp(path, "/") != 0) return -ENOTDIR;
+    filler(buf, ".", nullptr, 0, (fuse_fill_dir_flags)0);
+    filler(buf, "..", nullptr, 0, (fuse_fill_dir_flags)0);
+    for (size_t i : g_mount.files) {
+        if (filler(buf, g_mount.names[i].c_str(), nullptr, 0, (fuse_fill_dir_flags)0)) return 0;
+    }
+    filler(buf, "_manifest.txt", nullptr, 0, (fuse_fill_dir_flags)0);
+    return 0;
+}
+
+static int mount_open(const char* path, struct fuse_file_info* fi) {
+    if ((fi->flags & O_ACCMODE) != O_RDONLY) return -EROFS;
+    if (strcmp(path, "/_manifest.txt") == 0) {
+        mount_fill_digests();
+        fi->fh = MOUNT_MANIFEST;
+    } else {
+        auto it = g_mount.by_name.find(path + 1);
+        if (it == g_mount.by_name.end()) return -ENOENT;
+        fi->fh = it->second;
+    }
+    fi->keep_cache = 1;
+    return 0;
+}
+
+static int mount_read(const char*, char* buf, size_t size, off_t off, struct fuse_file_info* fi) {
+    const uint8_t* data;
+    uint64_t len;
+    if (fi->fh == MOUNT_MANIFEST) {
+        data = (const uint8_t*)g_mount.manifest.data();
+        len = g_mount.manifest.size();
+    } else {
+        const auto& rl = g_mount.P.res_locs[fi->fh];
+        data = g_mount.P.raw.data() + g_mount.P.base() + rl.m_offset;
+        len = rl.m_size;
+    }
+    if (off < 0 || (uint64_t)off >= len) return 0;
+    size_t n = (size_t)std::min<uint64_t>(size, len - (uint64_t)off);
+    memcpy(buf, data + off, n);
+    return (int)n;
+}
+
+// Mounts the pack and serves it until unmounted (fusermount3 -u mountpoint).
+// fuse_args are passed on to libfuse (-f stays in the foreground, -d debugs).
+static int do_mount(const fs::path& pack_path, const fs::path& mountpoint, const fs::path& dict_path,
+                    const std::vector<std::string>& fuse_args) {
+    auto t0 = std::chrono::steady_clock::now();
+    MountedPack& M = g_mount;
+    M.P = parse_pcpack(pack_path);
+    if (stat(pack_path.c_str(), &M.pack_stat) != 0)
+        throw std::runtime_error("Cannot stat: " + pack_path.string());
+    
+    std::vector<uint32_t> wanted = pack_name_hashes(M.P);
+    load_hash_dictionary(dict_path, &wanted);
+    
+    // Same names as export, including which entry keeps a name two share
+    const ParsedPack& P = M.P;
+    M.names.resize(P.res_locs.size());
+    std::vector<uint8_t> in_bounds(P.res_locs.size());
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        M.names[i] = sanitize_filename(get_filename(rl.field_0.m_hash.source_hash_code, rl.field_0.m_type));
+        in_bounds[i] = (uint64_t)P.base() + rl.m_offset + rl.m_size <= P.raw.size();
+        if (!in_bounds[i] || M.names[i] == "_manifest.txt") continue;
+        M.by_name[M.names[i]] = i;
+    }
+    
+    M.manifest = manifest_header(P);
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        if (!in_bounds[i]) continue;
+        auto it = M.by_name.find(M.names[i]);
+        if (it != M.by_name.end() && it->second == i) M.files.push_back(i);
+        std::string line = manifest_line(i, P.res_locs[i], 0, M.names[i]);
+        M.digest_at.push_back({ i, M.manifest.size() + line.size() - M.names[i].size() - 18 });
+        M.manifest += line;
+    }
+    
+    report("Opened %s (%zu files) in %.1f ms, mounting on %s\n", pack_path.string().c_str(), M.files.size(),
+           seconds_since(t0) * 1e3, mountpoint.string().c_str());
+    fflush(stdout);
+    
+    struct fuse_operations ops{};
+    ops.init = mount_init;
+    ops.getattr = mount_getattr;
+    ops.readdir = mount_readdir;
+    ops.open = mount_open;
+    ops.read = mount_read;
+    
+    std::string opts = "ro,default_permissions,subtype=pcpack,fsname=";
+    for (char c : fs::absolute(pack_path).string()) {
+        if (c == ',' || c == '\\') opts += '\\';   // libfuse option escaping
+        opts += c;
+    }
+    std::vector<std::string> argv_s = { "pcpacktool", mountpoint.string(), "-o", opts };
+    argv_s.insert(argv_s.end(), fuse_args.begin(), fuse_args.end());
+    std::vector<char*> argv;
+    for (auto& a : argv_s) argv.push_back(&a[0]);
+    return fuse_main((int)argv.size(), argv.data(), &ops, nullptr);
+}
+
+#endif // PCPACK_WITH_FUSE
+
+// ==================== Batch ====================
+// One process for many packs: the dictionary is loaded once and packs run in
+// parallel. A job list has one job per line, '#' starts a comment:
+//
+//   export <pack|glob> [out_root]                          -> out_root/<stem>/
+//   import <pack|glob> <in_root> [out_root] [--align N] [--in-place] [--dedupe]
+//                                  [--layout L] [--small-align N] [--reuse-holes]
+//                                  reads in_root/<stem>/, writes out_root/<name>
+//
+// Without out_root, outputs go where the plain export/import would put them.
+
+struct BatchJob {
+    bool export_job = true;
+    fs::path pack;
+    fs::path dir;       // export: output folder, import: input folder
+    fs::path out;       // import output, empty for the default name
+    ImportOptions opt;
 };
-static_assert(sizeof(generic_mash_header) == 0x10, "");
 
-struct string_hash {
-    uint32_t source_hash_code;
-};
+// Splits a job line on whitespace; "double quotes" keep paths with spaces together
+static std::vector<std::string> split_job_line(const std::string& line) {
+    std::vector<std::string> tok;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && isspace((unsigned char)line[i])) ++i;
+        if (i >= line.size() || line[i] == '#') break;
+        std::string t;
+        bool quoted = false;
+        for (; i < line.size() && (quoted || !isspace((unsigned char)line[i])); ++i) {
+            if (line[i] == '"') quoted = !quoted;
+            else t += line[i];
+        }
+        tok.push_back(t);
+    }
+    return tok;
+}
+
+static void add_batch_jobs(std::vector<BatchJob>& jobs, std::vector<std::string> tok) {
+    BatchJob base;
+    base.opt.align = std::stoul(take_option(tok, "--align", "16"));
+    base.opt.in_place = take_flag(tok, "--in-place");
+    base.opt.dedupe = take_flag(tok, "--dedupe");
+    base.opt.layout = parse_layout(take_option(tok, "--layout", "original"));
+    base.opt.reuse_holes = take_flag(tok, "--reuse-holes");
+    base.opt.small_align = std::stoul(take_option(tok, "--small-align", "0"));
+    
+    if (tok.size() >= 2 && tok[0] == "export") {
+        fs::path out_root = (tok.size() > 2) ? tok[2] : "";
+        for (const auto& pack : expand_glob(tok[1])) {
+            BatchJob j = base;
+            j.pack = pack;
+            if (!out_root.empty()) j.dir = out_root / pack.stem();
+            jobs.push_back(j);
+        }
+    } else if (tok.size() >= 3 && tok[0] == "import") {
+        fs::path in_root = tok[2];
+        fs::path out_root = (tok.size() > 3) ? tok[3] : "";
+        for (const auto& pack : expand_glob(tok[1])) {
+            BatchJob j = base;
+            j.export_job = false;
+            j.pack = pack;
+            j.dir = in_root / pack.stem();
+            if (!out_root.empty()) j.out = out_root / pack.filename();
+            jobs.push_back(j);
+        }
+    } else {
+        std::string line;
+        for (const auto& t : tok) line += (line.empty() ? "" : " ") + t;
+        throw std::runtime_error("Bad batch job: " + line);
+    }
+}
+
+// Runs every job on up to `threads` threads. Returns the number that failed.
+static size_t run_batch(const std::vector<BatchJob>& jobs, const fs::path& dict_path,
+                        unsigned threads, bool verbose) {
+    load_hash_dictionary(dict_path);
+    
+    // Per-resource output of parallel packs would interleave into noise
+    if (threads != 1 && !verbose) g_verbose = false;
+    
+    printf("Running %zu jobs\n", jobs.size());
+    auto t0 = std::chrono::steady_clock::now();
+    std::atomic<size_t> done{0}, failed{0};
+    
+    parallel_for(jobs.size(), threads, [&](size_t i) {
+        const BatchJob& j = jobs[i];
+        auto t1 = std::chrono::steady_clock::now();
+        std::string error;
+        try {
+            // An empty dictionary path keeps the one loaded above
+            if (j.export_job) do_export(j.pack, j.dir, "", 1);
+            else do_import(j.pack, j.dir, j.out, "", j.opt);
+        } catch (const std::exception& e) {
+            error = e.what();
+            failed++;
+        }
+        size_t n = ++done;
+        if (error.empty())
+            printf("[%zu/%zu] %s %s: ok (%.2f s)\n", n, jobs.size(), j.export_job ? "export" : "import",
+                   j.pack.string().c_str(), seconds_since(t1));
+        else
+            printf("[%zu/%zu] %s %s: FAILED: %s\n", n, jobs.size(), j.export_job ? "export" : "import",
+                   j.pack.string().c_str(), error.c_str());
+        fflush(stdout);
+    });
+    
+    g_verbose = true;
+    printf("\nBatch complete: %zu ok, %zu failed in %.2f s\n",
+           jobs.size() - failed, (size_t)failed, seconds_since(t0));
+    return failed;
+}
+
+// ==================== Crack ====================
+// Recovers the names of hashes missing from the dictionary. string_hash is
+// h = h * 33 + c, so hash(a + b) = hash(a) * 33^len(b) + hash(b): a candidate
+// is a row of slots (prefix, words, suffix, or one charset character per
+// slot) hashed one slot at a time. The last slot of every candidate is one
+// multiply-add per part over flat arrays, which the compiler vectorizes.
 
-struct resource_key {
-    string_hash m_hash;
-    uint32_t    m_type;
+struct CrackSlot {
+    std::vector<std::string> parts;
+    std::vector<uint32_t> hash;   // string_hash of each part
+    std::vector<uint32_t> mul;    // 33^len of each part
 };
 
-struct resource_location {
-    resource_key field_0;
-    uint32_t     m_offset;  // relative to base (res_dir_mash_size)
-    uint32_t     m_size;
-};
-static_assert(sizeof(resource_location) == 0x10, "");
-
-template<typename T>
-struct mashable_vector_t {
-    uint32_t m_data;    // on-disk pointer placeholder
-    uint16_t m_size;    // element count
-    uint8_t  m_shared;
-    uint8_t  field_7;
-};
-static_assert(sizeof(mashable_vector_t<uint32_t>) == 8, "");
+static CrackSlot make_crack_slot(const std::vector<std::string>& parts) {
+    CrackSlot s;
+    s.parts = parts;
+    for (const auto& p : parts) {
+        uint32_t m = 1;
+        for (size_t k = 0; k < p.size(); ++k) m *= 33;
+        s.hash.push_back(hash_string(p));
+        s.mul.push_back(m);
+    }
+    return s;
+}
 
-struct tlresource_location {
-    string_hash name;
-    uint8_t     type;
-    uint8_t     pad[3];
-    uint32_t    offset;  // relative to base
-};
-static_assert(sizeof(tlresource_location) == 0x0C, "");
-
-struct resource_directory {
-    mashable_vector_t<int32_t>             parents;               // 0x00
-    mashable_vector_t<resource_location>   resource_locations;    // 0x08
-    mashable_vector_t<tlresource_location> texture_locations;     // 0x10
-    mashable_vector_t<tlresource_location> mesh_file_locations;   // 0x18
-    mashable_vector_t<tlresource_location> mesh_locations;        // 0x20
-    mashable_vector_t<tlresource_location> morph_file_locations;  // 0x28
-    mashable_vector_t<tlresource_location> morph_locations;       // 0x30
-    mashable_vector_t<tlresource_location> material_file_locations; // 0x38
-    mashable_vector_t<tlresource_location> material_locations;    // 0x40
-    mashable_vector_t<tlresource_location> anim_file_locations;   // 0x48
-    mashable_vector_t<tlresource_location> anim_locations;        // 0x50
-    mashable_vector_t<tlresource_location> scene_anim_locations;  // 0x58
-    mashable_vector_t<tlresource_location> skeleton_locations;    // 0x60
-    mashable_vector_t<int32_t>             field_68;              // 0x68
-    mashable_vector_t<int32_t>             field_70;              // 0x70
-    int32_t pack_slot;     // 0x78
-    int32_t base;          // 0x7C - same as res_dir_mash_size
-    int32_t field_80;      // 0x80
-    int32_t field_84;      // 0x84
-    int32_t field_88;      // 0x88
-    int32_t type_start_idxs[70]; // 0x8C
-    int32_t type_end_idxs[70];   // 0x1A4
-};
-static_assert(sizeof(resource_directory) == 0x2BC, "");
-
-#pragma pack(pop)
-
-// ==================== Type Extension Table ====================
-
-static const std::vector<std::string> resource_type_ext = {
-    ".NONE",     // 0
-    ".PCANIM",   // 1
-    ".PCSKEL",   // 2
-    ".ALS",      // 3
-    ".ENT",      // 4
-    ".ENTEXT",   // 5
-    ".DDS",      // 6
-    ".DDSMP",    // 7
-    ".IFL",      // 8
-    ".DESC",     // 9
-    ".ENS",      // 10
-    ".SPL",      // 11
-    ".AB",       // 12
-    ".QP",       // 13
-    ".TRIG",     // 14
-    ".PCSX",     // 15
-    ".INST",     // 16
-    ".FDF",      // 17
-    ".PANEL",    // 18
-    ".TXT",      // 19
-    ".ICN",      // 20
-    ".PCMESH",   // 21
-    ".PCMORPH",  // 22
-    ".PCMAT",    // 23
-    ".COLL",     // 24
-    ".PCPACK",   // 25
-    ".PCSANIM",  // 26
-    ".MSN",      // 27
-    ".MARKER",   // 28
-    ".HH",       // 29
-    ".WAV",      // 30
-    ".WBK",      // 31
-    ".M2V",      // 32
-    "M2V",       // 33
-    ".PFX",      // 34
-    ".CSV",      // 35
-    ".CLE",      // 36
-    ".LIT",      // 37
-    ".GRD",      // 38
-    ".GLS",      // 39
-    ".LOD",      // 40
-    ".SIN",      // 41
-    ".GV",       // 42
-    ".SV",       // 43
-    ".TOKENS",   // 44
-    ".DSG",      // 45
-    ".PATH",     // 46
-    ".PTRL",     // 47
-    ".LANG",     // 48
-    ".SLF",      // 49
-    ".VISEME",   // 50
-    ".PCMESHDEF",// 51
-    ".PCMORPHDEF",// 52
-    ".PCMATDEF", // 53
-    ".MUT",      // 54
-    ".ASG",      // 55
-    ".BAI",      // 56
-    ".CUT",      // 57
-    ".INTERACT", // 58
-    ".CSV",      // 59
-    ".CSV",      // 60
-    "._ENTID_",  // 61
-    "._ANIMID_", // 62
-    "._REGIONID_",// 63
-    "._AI_GENERIC_ID_",// 64
-    "._RADIOMSG_",// 65
-    "._GOAL_",   // 66
-    "._IFC_ATTRIBUTE_",// 67
-    "._SIGNAL_", // 68
-    "._PACKGROUP_"// 69
+// Target hashes: a bitmap probe that rejects almost every candidate, then an
+// exact binary search for the few that pass
+struct HashFilter {
+    std::vector<uint64_t> bits;
+    unsigned shift = 32;
+    std::vector<uint32_t> targets;   // sorted
+    
+    void build(std::vector<uint32_t> t) {
+        std::sort(t.begin(), t.end());
+        t.erase(std::unique(t.begin(), t.end()), t.end());
+        targets = t;
+        unsigned log2 = 16;
+        while (log2 < 26 && (1ull << log2) < targets.size() * 64) ++log2;
+        shift = 32 - log2;
+        bits.assign(((size_t)1 << log2) / 64, 0);
+        for (uint32_t h : targets) {
+            uint32_t b = slot(h);
+            bits[b >> 6] |= 1ull << (b & 63);
+        }
+    }
+    uint32_t slot(uint32_t h) const { return (h * 0x9E3779B1u) >> shift; }
+    bool maybe(uint32_t h) const { uint32_t b = slot(h); return (bits[b >> 6] >> (b & 63)) & 1; }
+    bool contains(uint32_t h) const { return maybe(h) && std::binary_search(targets.begin(), targets.end(), h); }
 };
 
-// ==================== Helpers ====================
-
-static std::unordered_map<uint32_t, std::string> g_hashDict;
+struct CrackHit {
+    uint32_t hash;
+    std::string name;
+};
 
-static void load_hash_dictionary(const fs::path& path) {
-    if (path.empty() || !fs::exists(path)) return;
-    std::ifstream f(path);
-    if (!f) return;
-    std::string line;
-    while (std::getline(f, line)) {
-        if (line.empty()) continue;
-        std::istringstream iss(line);
-        std::string hex_str, name;
-        if (!(iss >> hex_str >> name)) continue;
-        if (hex_str.size() >= 2 && (hex_str[0] == '0' && (hex_str[1] == 'x' || hex_str[1] == 'X'))) {
-            uint32_t v = (uint32_t)std::stoul(hex_str, nullptr, 16);
-            g_hashDict[v] = name;
+// One work item: every combination of the slots after the leading ones, with
+// the last slot limited to [c0, c1)
+struct CrackWalk {
+    const std::vector<const CrackSlot*>& pat;
+    const HashFilter& filter;
+    size_t c0 = 0, c1 = 0;
+    std::vector<size_t> idx;
+    std::vector<uint32_t> out;
+    std::vector<CrackHit> found;
+    uint64_t count = 0;
+    
+    CrackWalk(const std::vector<const CrackSlot*>& p, const HashFilter& f) : pat(p), filter(f), idx(p.size(), 0) {}
+    
+    void walk(size_t s, uint32_t h) {
+        if (s + 1 == pat.size()) { leaf(h); return; }
+        const CrackSlot& sl = *pat[s];
+        for (size_t i = 0; i < sl.parts.size(); ++i) {
+            idx[s] = i;
+            walk(s + 1, h * sl.mul[i] + sl.hash[i]);
         }
     }
-    printf("Loaded %zu hash entries from dictionary\n", g_hashDict.size());
+    
+    void leaf(uint32_t h) {
+        const CrackSlot& last = *pat.back();
+        const uint32_t* mul = &last.mul[c0];
+        const uint32_t* add = &last.hash[c0];
+        const size_t m = c1 - c0;
+        uint32_t* o = out.data();
+        for (size_t k = 0; k < m; ++k) o[k] = h * mul[k] + add[k];
+        for (size_t k = 0; k < m; ++k) {
+            if (!filter.contains(o[k])) continue;
+            std::string name;
+            for (size_t t = 0; t + 1 < pat.size(); ++t) name += pat[t]->parts[idx[t]];
+            found.push_back({ o[k], name + last.parts[c0 + k] });
+        }
+        count += m;
+    }
+};
+
+// Tries every candidate of one slot pattern on `jobs` threads and returns how
+// many there were. Work items are a position in the leading slots times a
+// chunk of the last one.
+static uint64_t crack_pattern(const std::vector<const CrackSlot*>& pat, const HashFilter& filter,
+                              unsigned jobs, std::vector<CrackHit>& hits) {
+    const size_t CHUNK = 4096;
+    for (const CrackSlot* sl : pat) {
+        if (sl->parts.empty()) return 0;
+    }
+    const size_t n = pat.size();
+    const CrackSlot& last = *pat[n - 1];
+    const size_t chunks = (last.parts.size() + CHUNK - 1) / CHUNK;
+    
+    unsigned threads = jobs ? jobs : std::max(1u, std::thread::hardware_concurrency());
+    size_t lead = 0, lead_count = 1;
+    while (lead + 1 < n && lead_count * chunks < (size_t)threads * 64)
+        lead_count *= pat[lead++]->parts.size();
+    
+    std::mutex mu;
+    std::atomic<uint64_t> tried{0};
+    parallel_for(lead_count * chunks, jobs, [&](size_t w) {
+        CrackWalk cw(pat, filter);
+        cw.out.resize(CHUNK);
+        cw.c0 = (w % chunks) * CHUNK;
+        cw.c1 = std::min(last.parts.size(), cw.c0 + CHUNK);
+        
+        uint32_t h = 0;
+        size_t rest = w / chunks;
+        for (size_t s = lead; s-- > 0; ) {
+            cw.idx[s] = rest % pat[s]->parts.size();
+            rest /= pat[s]->parts.size();
+        }
+        for (size_t s = 0; s < lead; ++s)
+            h = h * pat[s]->mul[cw.idx[s]] + pat[s]->hash[cw.idx[s]];
+        cw.walk(lead, h);
+        
+        tried += cw.count;
+        if (!cw.found.empty()) {
+            std::lock_guard<std::mutex> lock(mu);
+            hits.insert(hits.end(), cw.found.begin(), cw.found.end());
+        }
+    });
+    return tried;
 }
 
-static std::string get_ext(uint32_t type) {
-    return (type < resource_type_ext.size()) ? resource_type_ext[type] : ".UNK";
+// A list given inline ("_LOD1,_LOD2") or as a file with one entry per line
+static std::vector<std::string> read_crack_list(const std::string& spec) {
+    std::vector<std::string> out;
+    std::error_code ec;
+    if (fs::is_regular_file(spec, ec)) {
+        std::ifstream in(spec);
+        std::string line;
+        while (std::getline(in, line)) {
+            while (!line.empty() && isspace((unsigned char)line.back())) line.pop_back();
+            size_t b = 0;
+            while (b < line.size() && isspace((unsigned char)line[b])) ++b;
+            if (b < line.size()) out.push_back(line.substr(b));
+        }
+    } else {
+        size_t pos = 0;
+        while (pos <= spec.size()) {
+            size_t comma = spec.find(',', pos);
+            if (comma == std::string::npos) comma = spec.size();
+            if (comma > pos) out.push_back(spec.substr(pos, comma - pos));
+            pos = comma + 1;
+        }
+    }
+    return out;
 }
 
-static std::string get_filename(uint32_t hash, uint32_t type) {
-    auto it = g_hashDict.find(hash);
-    char hex[16];
-    snprintf(hex, sizeof(hex), "0x%08X", hash);
-    std::string base = (it != g_hashDict.end()) ? it->second : std::string(hex);
-    return base + get_ext(type);
-}
-
-static std::string sanitize_filename(const std::string& name) {
-    std::string result = name;
-    for (char& c : result) {
-        if (c < 32 || c == ':' || c == '*' || c == '?' || c == '"' ||
-            c == '<' || c == '>' || c == '|' || c == '/' || c == '\\')
-            c = '_';
-    }
-    return result;
-}
-
-static std::vector<uint8_t> read_file(const fs::path& path) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) throw std::runtime_error("Cannot open: " + path.string());
-    f.seekg(0, std::ios::end);
-    size_t sz = (size_t)f.tellg();
-    f.seekg(0, std::ios::beg);
-    std::vector<uint8_t> data(sz);
-    if (sz > 0) f.read((char*)data.data(), sz);
-    return data;
-}
-
-static void write_file(const fs::path& path, const std::vector<uint8_t>& data) {
-    std::ofstream f(path, std::ios::binary);
-    if (!f) throw std::runtime_error("Cannot write: " + path.string());
-    if (!data.empty()) f.write((const char*)data.data(), data.size());
-}
-
-static size_t align_up(size_t x, size_t a) {
-    if (a <= 1) return x;
-    size_t m = x % a;
-    return m ? x + (a - m) : x;
-}
-
-// ==================== Parsed PCPACK ====================
-
-struct ParsedPack {
-    std::vector<uint8_t> raw;
-    
-    resource_pack_header pack_header;
-    generic_mash_header  mash_header;
-    resource_directory   dir;
-    
-    std::vector<int32_t>             parents;
-    std::vector<resource_location>   res_locs;
-    std::vector<tlresource_location> textures;
-    std::vector<tlresource_location> mesh_files;
-    std::vector<tlresource_location> meshes;
-    std::vector<tlresource_location> morph_files;
-    std::vector<tlresource_location> morphs;
-    std::vector<tlresource_location> material_files;
-    std::vector<tlresource_location> materials;
-    std::vector<tlresource_location> anim_files;
-    std::vector<tlresource_location> anims;
-    std::vector<tlresource_location> scene_anims;
-    std::vector<tlresource_location> skeletons;
-    
-    uint32_t base() const { return pack_header.res_dir_mash_size; }
+struct CrackOptions {
+    std::vector<std::string> words;   // --words lists
+    bool dict_words = false;          // also use every name in the dictionary as a word
+    std::vector<std::string> prefixes;
+    std::vector<std::string> suffixes;
+    std::string separators;           // tried between combined words, besides nothing
+    size_t combine = 1;               // up to this many words per candidate
+    std::string charset;              // brute force from min_len to max_len characters
+    size_t min_len = 1;
+    size_t max_len = 0;
+    unsigned jobs = 0;
 };
 
-static ParsedPack parse_pcpack(const fs::path& path) {
-    ParsedPack P;
-    P.raw = read_file(path);
+// Looks for the names of every hash in the packs that the dictionary cannot
+// resolve and prints them. Only with write are they appended to out_path (the
+// text dictionary when empty): a 32-bit hash makes brute force find
+// collisions, which must not pass for real names without a look first.
+static void do_crack(const std::vector<fs::path>& packs, const fs::path& dict_path, const CrackOptions& opt,
+                     const fs::path& out_path, bool write) {
+    load_hash_dictionary(dict_path);
+    std::vector<std::string> word_list = opt.words;
+    if (opt.dict_words) {
+        for (size_t i = 0; i < g_hashDict.size(); ++i)
+            word_list.push_back(g_hashDict.blob + g_hashDict.offsets[i]);
+    }
     
-    if (P.raw.size() < sizeof(resource_pack_header))
-        throw std::runtime_error("File too small for header");
+    std::vector<uint32_t> targets;
+    for (const auto& pack : packs) {
+        ParsedPack P = read_pack_directory(pack);
+        for (const auto& rl : P.res_locs) {
+            if (!g_hashDict.find(rl.field_0.m_hash.source_hash_code))
+                targets.push_back(rl.field_0.m_hash.source_hash_code);
+        }
+    }
+    HashFilter filter;
+    filter.build(targets);
+    printf("%zu unresolved hashes in %zu pack(s)\n", filter.targets.size(), packs.size());
+    if (filter.targets.empty()) return;
     
-    memcpy(&P.pack_header, P.raw.data(), sizeof(P.pack_header));
+    auto with_empty = [](const std::vector<std::string>& v) {
+        std::vector<std::string> out(1);
+        out.insert(out.end(), v.begin(), v.end());
+        return out;
+    };
+    CrackSlot pre = make_crack_slot(with_empty(opt.prefixes));
+    CrackSlot suf = make_crack_slot(with_empty(opt.suffixes));
+    CrackSlot sep = make_crack_slot([&] {
+        std::vector<std::string> v(1);
+        for (char c : opt.separators) v.push_back(std::string(1, c));
+        return v;
+    }());
+    CrackSlot words = make_crack_slot(word_list);
+    CrackSlot chars = make_crack_slot([&] {
+        std::vector<std::string> v;
+        for (char c : opt.charset) v.push_back(std::string(1, c));
+        return v;
+    }());
     
-    uint32_t dir_off = P.pack_header.directory_offset;
-    if (dir_off + sizeof(generic_mash_header) + sizeof(resource_directory) > P.raw.size())
-        throw std::runtime_error("Invalid directory offset");
+    // Every pattern: optional prefix, the body, optional suffix
+    struct Pattern { std::string name; std::vector<const CrackSlot*> slots; };
+    std::vector<Pattern> patterns;
+    auto add_pattern = [&](std::string name, std::vector<const CrackSlot*> body) {
+        Pattern pt;
+        if (pre.parts.size() > 1) { pt.slots.push_back(&pre); name = "prefix+" + name; }
+        pt.slots.insert(pt.slots.end(), body.begin(), body.end());
+        if (suf.parts.size() > 1) { pt.slots.push_back(&suf); name += "+suffix"; }
+        pt.name = name;
+        patterns.push_back(pt);
+    };
+    if (!words.parts.empty()) {
+        for (size_t k = 1; k <= opt.combine; ++k) {
+            std::vector<const CrackSlot*> body(1, &words);
+            for (size_t j = 1; j < k; ++j) {
+                if (sep.parts.size() > 1) body.push_back(&sep);
+                body.push_back(&words);
+            }
+            add_pattern(std::to_string(k) + (k == 1 ? " word" : " words"), body);
+        }
+    }
+    if (!chars.parts.empty()) {
+        for (size_t len = std::max<size_t>(1, opt.min_len); len <= opt.max_len; ++len)
+            add_pattern(std::to_string(len) + " chars", std::vector<const CrackSlot*>(len, &chars));
+    }
+    if (patterns.empty())
+        throw std::runtime_error("Nothing to try: give --words, --dict-words or --charset with --max-len");
     
-    memcpy(&P.mash_header, &P.raw[dir_off], sizeof(P.mash_header));
-    memcpy(&P.dir, &P.raw[dir_off + sizeof(generic_mash_header)], sizeof(P.dir));
+    std::vector<CrackHit> hits;
+    auto t_all = std::chrono::steady_clock::now();
+    uint64_t total = 0;
+    for (const auto& pt : patterns) {
+        auto t0 = std::chrono::steady_clock::now();
+        size_t before = hits.size();
+        uint64_t tried = crack_pattern(pt.slots, filter, opt.jobs, hits);
+        double sec = seconds_since(t0);
+        total += tried;
+        printf("  %-24s %14llu candidates  %8.2f s  %8.1f M/s  %zu hits\n", pt.name.c_str(),
+               (unsigned long long)tried, sec, sec > 0 ? tried / 1e6 / sec : 0.0, hits.size() - before);
+    }
+    double sec = seconds_since(t_all);
+    printf("Tried %llu candidates in %.2f s (%.1f M/s)\n", (unsigned long long)total, sec,
+           sec > 0 ? total / 1e6 / sec : 0.0);
     
-    // Parse vector data after directory
-    size_t pos = dir_off + sizeof(generic_mash_header) + sizeof(resource_directory);
+    // One name per hash: the shortest, then the first alphabetically. Other
+    // names with the same hash are most likely collisions.
+    std::sort(hits.begin(), hits.end(), [](const CrackHit& a, const CrackHit& b) {
+        if (a.hash != b.hash) return a.hash < b.hash;
+        if (a.name.size() != b.name.size()) return a.name.size() < b.name.size();
+        return a.name < b.name;
+    });
+    std::vector<CrackHit> resolved;
+    for (size_t i = 0; i < hits.size(); ) {
+        size_t j = i;
+        while (j < hits.size() && hits[j].hash == hits[i].hash) ++j;
+        resolved.push_back(hits[i]);
+        if (j - i > 1) printf("  0x%08X  %s  (+%zu other names)\n", hits[i].hash, hits[i].name.c_str(), j - i - 1);
+        else printf("  0x%08X  %s\n", hits[i].hash, hits[i].name.c_str());
+        i = j;
+    }
+    printf("Resolved %zu of %zu hashes\n", resolved.size(), filter.targets.size());
+    if (resolved.empty()) return;
+    if (!write) {
+        printf("Nothing written; check the names, then run again with --write to add them\n");
+        return;
+    }
     
-    auto read_align = [&]() {
-        pos = align_up(pos, 8);
-        pos = align_up(pos, 4);
-    };
+    fs::path target = out_path.empty() ? dict_path : out_path;
+    if (target.empty())
+        throw std::runtime_error("No dictionary to write to: give --dict or --out");
     
-    auto read_i32_vec = [&](uint16_t count) -> std::vector<int32_t> {
-        read_align();
-        std::vector<int32_t> v(count);
-        if (count > 0) {
-            memcpy(v.data(), &P.raw[pos], count * sizeof(int32_t));
-            pos += count * sizeof(int32_t);
+    // Match the line endings of the file being extended
+    std::string eol = "\n";
+    bool needs_eol = false;
+    {
+        std::ifstream in(target, std::ios::binary);
+        char magic[4] = {};
+        if (in && in.read(magic, 4) && memcmp(magic, "PCHD", 4) == 0)
+            throw std::runtime_error("Cannot append to a compiled dictionary, give --out dictionary.txt");
+        in.clear();
+        in.seekg(0);
+        std::string first;
+        if (std::getline(in, first) && !first.empty() && first.back() == '\r') eol = "\r\n";
+        in.clear();
+        in.seekg(0, std::ios::end);
+        if (in.tellg() > 0) {
+            in.seekg(-1, std::ios::end);
+            needs_eol = in.get() != '\n';
         }
-        pos = align_up(pos, 4);
-        return v;
-    };
+    }
+    std::ofstream of(target, std::ios::binary | std::ios::app);
+    if (!of) throw std::runtime_error("Cannot write: " + target.string());
+    if (needs_eol) of << eol;
+    for (const auto& h : resolved) {
+        char hex[16];
+        snprintf(hex, sizeof(hex), "0x%08x", h.hash);
+        of << hex << '\t' << h.name << eol;
+    }
+    if (!of) throw std::runtime_error("Write failed: " + target.string());
+    printf("Appended %zu names to %s\n", resolved.size(), target.string().c_str());
+}
+
+// ==================== Bench ====================
+
+// Remaps tl_offsets over locs with the old per-entry linear scan and with
+// OffsetRemap and prints both times. Both must agree.
+static void bench_remap_case(const char* name, const std::vector<resource_location>& locs,
+                             const std::vector<uint32_t>& new_offsets, const std::vector<uint32_t>& tl_offsets) {
+    size_t count = locs.size();
+    printf("Remapping %zu tlresource_locations over %zu resources (%s)\n", tl_offsets.size(), count, name);
     
-    auto read_res_locs = [&](uint16_t count) -> std::vector<resource_location> {
-        read_align();
-        std::vector<resource_location> v(count);
-        if (count > 0) {
-            memcpy(v.data(), &P.raw[pos], count * sizeof(resource_location));
-            pos += count * sizeof(resource_location);
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint32_t> linear(tl_offsets.size());
+    for (size_t k = 0; k < tl_offsets.size(); ++k) {
+        uint32_t off = tl_offsets[k];
+        linear[k] = off;
+        for (size_t i = 0; i < count; ++i) {
+            if (off >= locs[i].m_offset && off < locs[i].m_offset + locs[i].m_size) {
+                linear[k] = new_offsets[i] + (off - locs[i].m_offset);
+                break;
+            }
         }
-        pos = align_up(pos, 4);
-        return v;
-    };
+    }
+    double t_linear = seconds_since(t0);
     
-    auto read_tl_locs = [&](uint16_t count) -> std::vector<tlresource_location> {
-        read_align();
-        std::vector<tlresource_location> v(count);
-        if (count > 0) {
-            memcpy(v.data(), &P.raw[pos], count * sizeof(tlresource_location));
-            pos += count * sizeof(tlresource_location);
+    t0 = std::chrono::steady_clock::now();
+    OffsetRemap remap;
+    for (size_t i = 0; i < count; ++i)
+        remap.add(locs[i].m_offset, locs[i].m_size, new_offsets[i]);
+    remap.finish();
+    std::vector<uint32_t> indexed(tl_offsets.size());
+    for (size_t k = 0; k < tl_offsets.size(); ++k)
+        indexed[k] = remap.map(tl_offsets[k]);
+    double t_indexed = seconds_since(t0);
+    
+    if (linear != indexed)
+        throw std::runtime_error(std::string("bench remap: indexed result differs from linear scan (") + name + ")");
+    
+    printf("  linear scan:  %10.3f ms\n", t_linear * 1e3);
+    printf("  OffsetRemap:  %10.3f ms (including sort)\n", t_indexed * 1e3);
+    printf("  speedup:      %10.1fx\n", t_indexed > 0 ? t_linear / t_indexed : 0.0);
+}
+
+// Remaps one tlresource_location per resource of a synthetic directory, once
+// with back to back payloads and once where every 50th payload also covers
+// the next few. Where ranges overlap, the first entry in index order wins.
+static void bench_remap(size_t count) {
+    std::mt19937 rng(0x5EED);
+    std::vector<resource_location> locs(count);
+    std::vector<uint32_t> new_offsets(count);
+    uint32_t old_cursor = 0, new_cursor = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t size = 16 + rng() % 4096;
+        old_cursor = (uint32_t)align_up(old_cursor, 16);
+        new_cursor = (uint32_t)align_up(new_cursor, 2048);
+        locs[i].field_0.m_hash.source_hash_code = rng();
+        locs[i].field_0.m_type = 6;
+        locs[i].m_offset = old_cursor;
+        locs[i].m_size = size;
+        new_offsets[i] = new_cursor;
+        old_cursor += size;
+        new_cursor += size;
+    }
+    auto pick_offsets = [&] {
+        std::vector<uint32_t> tl_offsets(count);
+        for (size_t i = 0; i < count; ++i) {
+            const auto& rl = locs[rng() % count];
+            tl_offsets[i] = rl.m_offset + rng() % rl.m_size;
         }
-        pos = align_up(pos, 4);
-        return v;
+        return tl_offsets;
     };
+    bench_remap_case("disjoint", locs, new_offsets, pick_offsets());
     
-    P.parents = read_i32_vec(P.dir.parents.m_size);
-    P.res_locs = read_res_locs(P.dir.resource_locations.m_size);
-    P.textures = read_tl_locs(P.dir.texture_locations.m_size);
-    P.mesh_files = read_tl_locs(P.dir.mesh_file_locations.m_size);
-    P.meshes = read_tl_locs(P.dir.mesh_locations.m_size);
-    P.morph_files = read_tl_locs(P.dir.morph_file_locations.m_size);
-    P.morphs = read_tl_locs(P.dir.morph_locations.m_size);
-    P.material_files = read_tl_locs(P.dir.material_file_locations.m_size);
-    P.materials = read_tl_locs(P.dir.material_locations.m_size);
-    P.anim_files = read_tl_locs(P.dir.anim_file_locations.m_size);
-    P.anims = read_tl_locs(P.dir.anim_locations.m_size);
-    P.scene_anims = read_tl_locs(P.dir.scene_anim_locations.m_size);
-    P.skeletons = read_tl_locs(P.dir.skeleton_locations.m_size);
-    
-    return P;
+    for (size_t i = 0; i < count; i += 50) {
+        size_t last = std::min(count - 1, i + 1 + rng() % 4);
+        locs[i].m_size = locs[last].m_offset + locs[last].m_size - locs[i].m_offset + (uint32_t)(rng() % 64);
+    }
+    bench_remap_case("overlapping", locs, new_offsets, pick_offsets());
 }
 
-// ==================== Export ====================
+// Shape of a generated pack
+struct SyntheticSpec {
+    size_t   resources = 2000;
+    size_t   tl_entries = 2000;      // spread over the texture/mesh/material/anim/skeleton vectors
+    uint32_t min_size = 64;
+    uint32_t max_size = 256 * 1024;
+    bool     log_sizes = true;       // log-uniform sizes (many small, few large) instead of uniform
+    uint32_t seed = 1;
+};
 
-static void do_export(const fs::path& pack_path, const fs::path& out_dir, const fs::path& dict_path) {
-    load_hash_dictionary(dict_path);
+// Writes a pack with the resource_directory layout of the game: resources
+// sorted by type then hash, type ranges filled in, TL entries pointing into
+// payloads and random payload bytes. Returns the file size.
+static uint64_t write_synthetic_pack(const fs::path& path, const SyntheticSpec& spec) {
+    if (spec.resources > 0xFFFF) throw std::runtime_error("At most 65535 resources per pack");
+    if (spec.min_size > spec.max_size) throw std::runtime_error("min size is above max size");
+    std::mt19937_64 rng(spec.seed);
     
-    printf("Parsing %s...\n", pack_path.string().c_str());
-    ParsedPack P = parse_pcpack(pack_path);
+    // Types that own a TL vector, plus a couple that do not
+    static const uint32_t types[] = { 1, 2, 6, 19, 21, 23, 35 };
+    ParsedPack P;
+    P.res_locs.resize(spec.resources);
+    for (auto& rl : P.res_locs) {
+        rl.field_0.m_hash.source_hash_code = (uint32_t)rng();
+        rl.field_0.m_type = types[rng() % (sizeof(types) / sizeof(types[0]))];
+        double u = (double)(rng() >> 11) / (double)(1ULL << 53);
+        rl.m_size = spec.log_sizes ?
+            (uint32_t)(spec.min_size * std::pow((double)spec.max_size / std::max(1u, spec.min_size), u)) :
+            spec.min_size + (uint32_t)(u * (spec.max_size - spec.min_size));
+    }
+    std::sort(P.res_locs.begin(), P.res_locs.end(), [](const resource_location& a, const resource_location& b) {
+        if (a.field_0.m_type != b.field_0.m_type) return a.field_0.m_type < b.field_0.m_type;
+        return a.field_0.m_hash.source_hash_code < b.field_0.m_hash.source_hash_code;
+    });
     
-    printf("PCPACK Info:\n");
-    printf("  Directory offset: 0x%X\n", P.pack_header.directory_offset);
-    printf("  Base (payload start): 0x%X (%u)\n", P.base(), P.base());
-    printf("  Resource locations: %zu\n", P.res_locs.size());
-    printf("  Texture locations: %zu\n", P.textures.size());
-    printf("  Mesh file locations: %zu\n", P.mesh_files.size());
-    printf("  Mesh locations: %zu\n", P.meshes.size());
-    printf("  Material locations: %zu\n", P.materials.size());
-    printf("  Anim file locations: %zu\n", P.anim_files.size());
-    printf("  Anim locations: %zu\n", P.anims.size());
-    printf("  Skeleton locations: %zu\n", P.skeletons.size());
+    uint64_t cursor = 0;
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        auto& rl = P.res_locs[i];
+        cursor = align_up(cursor, 16);
+        rl.m_offset = (uint32_t)cursor;
+        cursor += rl.m_size;
+        uint32_t t = rl.field_0.m_type;
+        if (P.dir.type_end_idxs[t] == 0) P.dir.type_start_idxs[t] = (int32_t)i;
+        P.dir.type_end_idxs[t] += 1;  // COUNT
+    }
+    if (cursor > 0xFFFFFFFFULL) throw std::runtime_error("Payloads exceed 4 GB");
     
-    fs::path target_dir = out_dir.empty() ? pack_path.stem() : out_dir;
-    fs::create_directories(target_dir);
+    std::vector<tlresource_location>* tl_vecs[] = { &P.textures, &P.meshes, &P.materials, &P.anims, &P.skeletons };
+    for (size_t k = 0; k < spec.tl_entries && !P.res_locs.empty(); ++k) {
+        auto* vec = tl_vecs[k % 5];
+        if (vec->size() == 0xFFFF) break;
+        const auto& rl = P.res_locs[rng() % P.res_locs.size()];
+        tlresource_location tl{};
+        tl.name.source_hash_code = (uint32_t)rng();
+        tl.type = (uint8_t)rl.field_0.m_type;
+        tl.offset = rl.m_offset + (rl.m_size ? (uint32_t)(rng() % rl.m_size) : 0);
+        vec->push_back(tl);
+    }
     
-    // Export manifest file for reimport
-    fs::path manifest_path = target_dir / "_manifest.txt";
-    std::ofstream manifest(manifest_path);
-    manifest << "# PCPACK Manifest\n";
-    manifest << "# base=" << P.base() << "\n";
-    manifest << "# resources=" << P.res_locs.size() << "\n\n";
+    P.parents = { 0 };
+    P.dir.parents.m_size = 1;
+    P.dir.resource_locations.m_size = (uint16_t)P.res_locs.size();
+    P.dir.texture_locations.m_size = (uint16_t)P.textures.size();
+    P.dir.mesh_locations.m_size = (uint16_t)P.meshes.size();
+    P.dir.material_locations.m_size = (uint16_t)P.materials.size();
+    P.dir.anim_locations.m_size = (uint16_t)P.anims.size();
+    P.dir.skeleton_locations.m_size = (uint16_t)P.skeletons.size();
+    P.pack_header.field_14 = 0x14;
+    P.pack_header.directory_offset = 0x30;
     
-    printf("\nExporting %zu resources to %s\n", P.res_locs.size(), target_dir.string().c_str());
+    // Base goes right after the directory vectors
+    uint32_t base = (uint32_t)align_up(serialize_directory(P).size(), 16);
+    P.pack_header.res_dir_mash_size = base;
+    P.dir.base = (int32_t)base;
+    P.mash_header.field_8 = (int32_t)(base - P.pack_header.directory_offset);
+    std::vector<uint8_t> head = serialize_directory(P);
     
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        const auto& rl = P.res_locs[i];
-        uint32_t hash = rl.field_0.m_hash.source_hash_code;
-        uint32_t type = rl.field_0.m_type;
-        uint64_t start = (uint64_t)P.base() + rl.m_offset;
-        uint64_t end = start + rl.m_size;
-        
-        if (end > P.raw.size()) {
-            printf("  [%zu] WARNING: payload out of bounds (0x%llX > 0x%zX)\n",
-                   i, (unsigned long long)end, P.raw.size());
-            continue;
-        }
-        
-        std::string fname = sanitize_filename(get_filename(hash, type));
-        fs::path out_path = target_dir / fname;
-        
-        std::ofstream of(out_path, std::ios::binary);
-        if (!of) {
-            printf("  [%zu] ERROR: cannot write %s\n", i, fname.c_str());
-            continue;
-        }
-        of.write((const char*)&P.raw[start], rl.m_size);
-        of.close();
-        
-        // Write to manifest: index hash type offset size filename
-        manifest << i << " 0x" << std::hex << hash << " " << std::dec << type
-                 << " 0x" << std::hex << rl.m_offset << " 0x" << rl.m_size
-                 << " " << fname << "\n";
-        
-        printf("  [%zu] %s (0x%X bytes at offset 0x%X)\n",
-               i, fname.c_str(), rl.m_size, rl.m_offset);
-    }
+    std::ofstream of(path, std::ios::binary);
+    if (!of) throw std::runtime_error("Cannot write: " + path.string());
+    of.write((const char*)head.data(), head.size());
     
-    manifest.close();
-    printf("\nExport complete. Manifest written to %s\n", manifest_path.string().c_str());
+    uint64_t out_size = head.size();
+    std::vector<uint64_t> buf;
+    for (const auto& rl : P.res_locs) {
+        uint64_t start = (uint64_t)base + rl.m_offset;
+        buf.assign((start - out_size + rl.m_size + 7) / 8, 0);
+        for (size_t k = (start - out_size) / 8; k < buf.size(); ++k) buf[k] = rng();
+        std::fill((char*)buf.data(), (char*)buf.data() + (start - out_size), 0);
+        of.write((const char*)buf.data(), start - out_size + rl.m_size);
+        out_size = start + rl.m_size;
+    }
+    of.close();
+    if (!of) throw std::runtime_error("Write failed: " + path.string());
+    return out_size;
 }
 
-// ==================== Import ====================
-
-static void do_import(const fs::path& orig_pack, const fs::path& input_dir,
-                      const fs::path& out_pack, size_t align_val) {
-    printf("Parsing original pack %s...\n", orig_pack.string().c_str());
-    ParsedPack P = parse_pcpack(orig_pack);
-    
-    printf("Original PCPACK base: 0x%X\n", P.base());
-    printf("Processing %zu resources...\n", P.res_locs.size());
-    
-    // Build old offset -> resource index mapping for tlresource_location updates
-    std::unordered_map<uint32_t, size_t> old_offset_to_idx;
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        old_offset_to_idx[P.res_locs[i].m_offset] = i;
+// Rewrites every step-th exported payload with fresh random bytes. grow adds
+// some bytes so the file no longer fits its slot.
+static void touch_exported_files(const fs::path& dir, const ParsedPack& P, size_t step, bool grow, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    for (size_t i = 0; i < P.res_locs.size(); i += step) {
+        const auto& rl = P.res_locs[i];
+        size_t size = rl.m_size + (grow ? 1 + rng() % 4096 : 0);
+        std::vector<uint64_t> data((size + 7) / 8);
+        for (auto& w : data) w = rng();
+        std::ofstream of(dir / sanitize_filename(get_filename(rl.field_0.m_hash.source_hash_code, rl.field_0.m_type)),
+                         std::ios::binary);
+        of.write((const char*)data.data(), size);
     }
+}
+
+// Times every pack path on a generated pack and prints the results as JSON.
+// MB/s is always relative to the size of the generated pack. Each phase
+// reports the largest resident set reached while it ran (RssPeakProbe), the
+// top-level peak_rss_kb covers the whole run.
+static void bench_pack(const SyntheticSpec& spec, const fs::path& work_dir, unsigned jobs, bool keep) {
+    fs::create_directories(work_dir);
+    fs::path pack_path = work_dir / "BENCH.PCPACK";
+    fs::path export_dir = work_dir / "BENCH";
     
-    // Calculate new offsets and sizes
-    struct NewResource {
-        uint32_t new_offset;
-        uint32_t new_size;
-        std::vector<uint8_t> data;
-        bool from_file;
+    struct Phase { const char* name; double seconds; uint64_t peak_rss_kb; };
+    std::vector<Phase> phases;
+    auto timed = [&](const char* name, auto fn) {
+        RssPeakProbe rss;
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        double seconds = seconds_since(t0);
+        phases.push_back({ name, seconds, rss.finish() });
     };
-    std::vector<NewResource> new_resources(P.res_locs.size());
     
-    uint32_t cursor = 0;  // offset relative to base
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        const auto& rl = P.res_locs[i];
-        uint32_t hash = rl.field_0.m_hash.source_hash_code;
-        uint32_t type = rl.field_0.m_type;
-        
-        std::string fname = sanitize_filename(get_filename(hash, type));
-        fs::path in_file = input_dir / fname;
-        
-        if (fs::exists(in_file)) {
-            new_resources[i].data = read_file(in_file);
-            new_resources[i].new_size = (uint32_t)new_resources[i].data.size();
-            new_resources[i].from_file = true;
-            printf("  [%zu] %s: from file (%u bytes)\n", i, fname.c_str(), new_resources[i].new_size);
-        } else {
-            // Keep original data
-            uint64_t start = (uint64_t)P.base() + rl.m_offset;
-            new_resources[i].data.resize(rl.m_size);
-            memcpy(new_resources[i].data.data(), &P.raw[start], rl.m_size);
-            new_resources[i].new_size = rl.m_size;
-            new_resources[i].from_file = false;
-            printf("  [%zu] %s: kept original (%u bytes)\n", i, fname.c_str(), rl.m_size);
-        }
+    g_verbose = false;
+    uint64_t pack_size = 0;
+    size_t tl_count = 0;
+    try {
+        timed("generate", [&] { pack_size = write_synthetic_pack(pack_path, spec); });
+        timed("parse", [&] {
+            ParsedPack P = parse_pcpack(pack_path);
+            tl_count = P.textures.size() + P.meshes.size() + P.materials.size() + P.anims.size() + P.skeletons.size();
+        });
+        timed("export", [&] { do_export(pack_path, export_dir, "", jobs); });
+        ImportOptions rebuild, in_place;
+        in_place.in_place = true;
+        timed("import_unchanged", [&] { do_import(pack_path, export_dir, work_dir / "UNCHANGED.PCPACK", "", rebuild); });
         
-        cursor = (uint32_t)align_up(cursor, align_val);
-        new_resources[i].new_offset = cursor;
-        cursor += new_resources[i].new_size;
+        ParsedPack P = parse_pcpack(pack_path);
+        touch_exported_files(export_dir, P, 100, false, spec.seed + 1);
+        timed("import_in_place", [&] { do_import(pack_path, export_dir, work_dir / "PATCHED.PCPACK", "", in_place); });
+        touch_exported_files(export_dir, P, 10, true, spec.seed + 2);
+        timed("import", [&] { do_import(pack_path, export_dir, work_dir / "REBUILT.PCPACK", "", rebuild); });
+        ImportOptions append = in_place;
+        append.layout = LAYOUT_APPEND;
+        timed("import_append_in_place", [&] { do_import(pack_path, export_dir, work_dir / "APPENDED.PCPACK", "", append); });
+        timed("reimport", [&] { do_reimport(pack_path, export_dir, work_dir / "REIMPORTED.PCPACK", "", rebuild); });
+    } catch (...) {
+        g_verbose = true;
+        throw;
     }
+    g_verbose = true;
     
-    // Build offset delta map: old_offset -> new_offset
-    std::unordered_map<uint32_t, uint32_t> offset_map;
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        offset_map[P.res_locs[i].m_offset] = new_resources[i].new_offset;
+    if (!keep) {
+        std::error_code ec;
+        fs::remove_all(work_dir, ec);
+    } else {
+        fprintf(stderr, "Bench files kept in %s\n", work_dir.string().c_str());
     }
     
-    // For tlresource_locations, find which resource they belong to and compute delta
-    auto update_tl_offset = [&](uint32_t old_off) -> uint32_t {
-        // Find which resource this offset falls within
-        for (size_t i = 0; i < P.res_locs.size(); ++i) {
-            uint32_t res_start = P.res_locs[i].m_offset;
-            uint32_t res_end = res_start + P.res_locs[i].m_size;
-            if (old_off >= res_start && old_off < res_end) {
-                // This tl belongs to resource i
-                uint32_t internal_off = old_off - res_start;
-                return new_resources[i].new_offset + internal_off;
-            }
-        }
-        // No match found - keep original (might be 0 or special value)
-        return old_off;
-    };
+    printf("{\n");
+    printf("  \"resources\": %zu,\n", spec.resources);
+    printf("  \"tl_entries\": %zu,\n", tl_count);
+    printf("  \"min_size\": %u,\n", spec.min_size);
+    printf("  \"max_size\": %u,\n", spec.max_size);
+    printf("  \"size_distribution\": \"%s\",\n", spec.log_sizes ? "log" : "uniform");
+    printf("  \"seed\": %u,\n", spec.seed);
+    printf("  \"jobs\": %u,\n", jobs);
+    printf("  \"pack_bytes\": %llu,\n", (unsigned long long)pack_size);
+    printf("  \"peak_rss_kb\": %llu,\n", (unsigned long long)peak_rss_kb());
+    printf("  \"phases\": [\n");
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const auto& ph = phases[i];
+        printf("    { \"name\": \"%s\", \"seconds\": %.6f, \"mb_per_s\": %.1f, \"peak_rss_kb\": %llu }%s\n",
+               ph.name, ph.seconds, ph.seconds > 0 ? pack_size / 1e6 / ph.seconds : 0.0,
+               (unsigned long long)ph.peak_rss_kb, i + 1 < phases.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+// Rebuilds one generated pack with every repacking layout and prints the
+// time, output size and padding of each as JSON.
+static void bench_layout(const SyntheticSpec& spec, const fs::path& work_dir, size_t align, size_t small_align, bool keep) {
+    fs::create_directories(work_dir);
+    fs::path pack_path = work_dir / "BENCH.PCPACK";
+    fs::path export_dir = work_dir / "BENCH";
     
-    // Update all tlresource_location offsets
-    auto update_tl_vec = [&](std::vector<tlresource_location>& vec, const char* name) {
-        for (auto& tl : vec) {
-            uint32_t old = tl.offset;
-            tl.offset = update_tl_offset(old);
-            if (old != tl.offset && vec.size() < 20) {
-                printf("    %s: 0x%X -> 0x%X\n", name, old, tl.offset);
+    struct Result { const char* name; double seconds; uint64_t bytes, padding; };
+    std::vector<Result> results;
+    
+    g_verbose = false;
+    try {
+        write_synthetic_pack(pack_path, spec);
+        do_export(pack_path, export_dir, "", 0);
+        for (PayloadLayout layout : { LAYOUT_ORIGINAL, LAYOUT_TYPE_HASH, LAYOUT_SIZE, LAYOUT_BINPACK }) {
+            ImportOptions opt;
+            opt.align = align;
+            opt.small_align = small_align;
+            opt.layout = layout;
+            fs::path out = work_dir / (std::string(layout_names[layout]) + ".PCPACK");
+            
+            auto t0 = std::chrono::steady_clock::now();
+            do_import(pack_path, export_dir, out, "", opt);
+            double seconds = seconds_since(t0);
+            
+            ParsedPack P = read_pack_directory(out);
+            uint64_t bytes = fs::file_size(out), stored = 0;
+            std::unordered_map<uint64_t, bool> seen;
+            for (const auto& rl : P.res_locs) {
+                if (seen.emplace(((uint64_t)rl.m_offset << 32) | rl.m_size, true).second) stored += rl.m_size;
             }
+            results.push_back({ layout_names[layout], seconds, bytes, bytes - P.base() - stored });
         }
-    };
-    
-    printf("\nUpdating tlresource_location offsets...\n");
-    update_tl_vec(P.textures, "texture");
-    update_tl_vec(P.mesh_files, "mesh_file");
-    update_tl_vec(P.meshes, "mesh");
-    update_tl_vec(P.morph_files, "morph_file");
-    update_tl_vec(P.morphs, "morph");
-    update_tl_vec(P.material_files, "material_file");
-    update_tl_vec(P.materials, "material");
-    update_tl_vec(P.anim_files, "anim_file");
-    update_tl_vec(P.anims, "anim");
-    update_tl_vec(P.scene_anims, "scene_anim");
-    update_tl_vec(P.skeletons, "skeleton");
-    
-    // Update resource_locations
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        P.res_locs[i].m_offset = new_resources[i].new_offset;
-        P.res_locs[i].m_size = new_resources[i].new_size;
+    } catch (...) {
+        g_verbose = true;
+        throw;
     }
+    g_verbose = true;
     
-    // Now rebuild the entire file
-    printf("\nRebuilding PCPACK...\n");
-    
-    std::vector<uint8_t> out;
-    
-    // Write pack header (unchanged except we'll verify base stays same)
-    out.resize(sizeof(resource_pack_header));
-    memcpy(out.data(), &P.pack_header, sizeof(P.pack_header));
+    if (!keep) {
+        std::error_code ec;
+        fs::remove_all(work_dir, ec);
+    } else {
+        fprintf(stderr, "Bench files kept in %s\n", work_dir.string().c_str());
+    }
     
-    // Pad to directory offset
-    if (out.size() < P.pack_header.directory_offset)
-        out.resize(P.pack_header.directory_offset, 0);
+    printf("{\n");
+    printf("  \"resources\": %zu,\n", spec.resources);
+    printf("  \"min_size\": %u,\n", spec.min_size);
+    printf("  \"max_size\": %u,\n", spec.max_size);
+    printf("  \"size_distribution\": \"%s\",\n", spec.log_sizes ? "log" : "uniform");
+    printf("  \"seed\": %u,\n", spec.seed);
+    printf("  \"align\": %zu,\n", align);
+    printf("  \"small_align\": %zu,\n", small_align ? small_align : align);
+    printf("  \"layouts\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        printf("    { \"name\": \"%s\", \"seconds\": %.6f, \"pack_bytes\": %llu, \"padding_bytes\": %llu, \"saved_bytes\": %lld }%s\n",
+               r.name, r.seconds, (unsigned long long)r.bytes, (unsigned long long)r.padding,
+               (long long)results[0].bytes - (long long)r.bytes, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+// Exports a generated pack of many small files and imports it back unchanged,
+// once per I/O backend, and prints the times as JSON. Both backends must
+// produce the same files and the same pack.
+static void bench_io(const SyntheticSpec& spec, const fs::path& work_dir, unsigned jobs, bool keep) {
+    fs::create_directories(work_dir);
+    fs::path pack_path = work_dir / "BENCH.PCPACK";
     
-    // Write mash header
-    out.insert(out.end(), (uint8_t*)&P.mash_header, (uint8_t*)&P.mash_header + sizeof(P.mash_header));
+    struct Result { const char* name; double export_seconds, import_seconds; };
+    std::vector<Result> results;
+    const IoBackend saved = g_io_backend;
     
-    // Write directory
-    out.insert(out.end(), (uint8_t*)&P.dir, (uint8_t*)&P.dir + sizeof(P.dir));
+    g_verbose = false;
+    uint64_t pack_size = 0;
+    try {
+        pack_size = write_synthetic_pack(pack_path, spec);
+        
+        std::vector<std::pair<const char*, IoBackend>> backends = { { "std", IO_STD } };
+        g_io_backend = IO_AUTO;
+        if (use_io_uring()) backends.push_back({ "uring", IO_URING });
+        
+        // One unmeasured round first so both backends start from a warm page cache
+        do_export(pack_path, work_dir / "WARMUP", "", jobs);
+        for (const auto& b : backends) {
+            g_io_backend = b.second;
+            fs::path dir = work_dir / b.first;
+            ImportOptions opt;
+            opt.jobs = jobs;
+            
+            auto t0 = std::chrono::steady_clock::now();
+            do_export(pack_path, dir, "", jobs);
+            double t_export = seconds_since(t0);
+            t0 = std::chrono::steady_clock::now();
+            do_import(pack_path, dir, work_dir / (std::string(b.first) + ".PCPACK"), "", opt);
+            double t_import = seconds_since(t0);
+            results.push_back({ b.first, t_export, t_import });
+        }
+        
+        for (size_t i = 1; i < backends.size(); ++i) {
+            fs::path a = work_dir / (std::string(backends[0].first) + ".PCPACK");
+            fs::path b = work_dir / (std::string(backends[i].first) + ".PCPACK");
+            MappedFile ma(a), mb(b);
+            if (ma.size() != mb.size() || memcmp(ma.data(), mb.data(), ma.size()) != 0)
+                throw std::runtime_error(std::string("bench io: ") + backends[i].first + " import differs from std");
+            for (const auto& e : fs::directory_iterator(work_dir / backends[0].first)) {
+                MappedFile fa(e.path()), fb(work_dir / backends[i].first / e.path().filename());
+                if (fa.size() != fb.size() || memcmp(fa.data(), fb.data(), fa.size()) != 0)
+                    throw std::runtime_error(std::string("bench io: ") + backends[i].first + " export differs from std");
+            }
+        }
+    } catch (...) {
+        g_verbose = true;
+        g_io_backend = saved;
+        throw;
+    }
+    g_verbose = true;
+    g_io_backend = saved;
     
-    // Helper to write vectors with alignment
-    auto emit_align = [&](size_t a, uint8_t fill = 0xE3) {
-        size_t want = align_up(out.size(), a);
-        if (want > out.size()) out.insert(out.end(), want - out.size(), fill);
-    };
+    if (!keep) {
+        std::error_code ec;
+        fs::remove_all(work_dir, ec);
+    } else {
+        fprintf(stderr, "Bench files kept in %s\n", work_dir.string().c_str());
+    }
     
-    auto emit_i32_vec = [&](const std::vector<int32_t>& v) {
-        emit_align(8); emit_align(4);
-        if (!v.empty()) {
-            const uint8_t* p = (const uint8_t*)v.data();
-            out.insert(out.end(), p, p + v.size() * sizeof(int32_t));
-        }
-        emit_align(4);
-    };
+    printf("{\n");
+    printf("  \"resources\": %zu,\n", spec.resources);
+    printf("  \"min_size\": %u,\n", spec.min_size);
+    printf("  \"max_size\": %u,\n", spec.max_size);
+    printf("  \"size_distribution\": \"%s\",\n", spec.log_sizes ? "log" : "uniform");
+    printf("  \"seed\": %u,\n", spec.seed);
+    printf("  \"jobs\": %u,\n", jobs);
+    printf("  \"pack_bytes\": %llu,\n", (unsigned long long)pack_size);
+    printf("  \"backends\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        printf("    { \"name\": \"%s\", \"export_seconds\": %.6f, \"import_unchanged_seconds\": %.6f, "
+               "\"files_per_s\": %.0f }%s\n",
+               r.name, r.export_seconds, r.import_seconds,
+               r.export_seconds > 0 ? spec.resources / r.export_seconds : 0.0, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+// Catalogs many small generated packs: a full build, a rebuild with nothing
+// changed, a rebuild after one pack changed, then random lookups. Prints JSON.
+static void bench_catalog(const SyntheticSpec& spec, size_t pack_count, size_t lookups, const fs::path& work_dir,
+                          unsigned jobs, bool keep) {
+    fs::path pack_dir = work_dir / "packs";
+    fs::path cat_path = work_dir / "BENCH.PCCT";
+    fs::create_directories(pack_dir);
     
-    auto emit_res_vec = [&](const std::vector<resource_location>& v) {
-        emit_align(8); emit_align(4);
-        if (!v.empty()) {
-            const uint8_t* p = (const uint8_t*)v.data();
-            out.insert(out.end(), p, p + v.size() * sizeof(resource_location));
-        }
-        emit_align(4);
+    auto pack_path = [&](size_t i) {
+        char name[48];
+        snprintf(name, sizeof(name), "BENCH%05zu.PCPACK", i);
+        return pack_dir / name;
     };
     
-    auto emit_tl_vec = [&](const std::vector<tlresource_location>& v) {
-        emit_align(8); emit_align(4);
-        if (!v.empty()) {
-            const uint8_t* p = (const uint8_t*)v.data();
-            out.insert(out.end(), p, p + v.size() * sizeof(tlresource_location));
-        }
-        emit_align(4);
-    };
+    struct Phase { const char* name; double seconds; size_t scanned; };
+    std::vector<Phase> phases;
+    uint64_t total_bytes = 0;
+    size_t entries = 0;
+    double lookup_seconds = 0;
     
-    emit_i32_vec(P.parents);
-    emit_res_vec(P.res_locs);
-    emit_tl_vec(P.textures);
-    emit_tl_vec(P.mesh_files);
-    emit_tl_vec(P.meshes);
-    emit_tl_vec(P.morph_files);
-    emit_tl_vec(P.morphs);
-    emit_tl_vec(P.material_files);
-    emit_tl_vec(P.materials);
-    emit_tl_vec(P.anim_files);
-    emit_tl_vec(P.anims);
-    emit_tl_vec(P.scene_anims);
-    emit_tl_vec(P.skeletons);
-    
-    // Pad to base offset
-    if (out.size() < P.base()) {
-        out.resize(P.base(), 0xE3);
-    }
-    
-    printf("Header area ends at 0x%zX, base is 0x%X\n", out.size(), P.base());
-    
-    // Write payload data
-    for (size_t i = 0; i < new_resources.size(); ++i) {
-        const auto& nr = new_resources[i];
-        size_t start = (size_t)P.base() + nr.new_offset;
+    g_verbose = false;
+    try {
+        std::vector<uint64_t> sizes(pack_count);
+        parallel_for(pack_count, jobs, [&](size_t i) {
+            SyntheticSpec s = spec;
+            s.seed = spec.seed + (uint32_t)i;
+            sizes[i] = write_synthetic_pack(pack_path(i), s);
+        });
+        for (uint64_t s : sizes) total_bytes += s;
         
-        // Ensure output is large enough
-        if (out.size() < start + nr.new_size) {
-            out.resize(start + nr.new_size, 0);
+        auto build = [&](const char* name) {
+            auto t0 = std::chrono::steady_clock::now();
+            CatalogStats st = catalog_build(pack_dir, cat_path, jobs, false);
+            phases.push_back({ name, seconds_since(t0), st.scanned });
+            entries = st.entries;
+        };
+        build("build");
+        build("rebuild_unchanged");
+        if (pack_count > 0) {
+            SyntheticSpec s = spec;
+            s.seed = spec.seed + (uint32_t)pack_count;
+            write_synthetic_pack(pack_path(pack_count / 2), s);
+            fs::last_write_time(pack_path(pack_count / 2), fs::file_time_type::clock::now() + std::chrono::seconds(1));
         }
+        build("rebuild_one_changed");
         
-        memcpy(&out[start], nr.data.data(), nr.new_size);
+        Catalog C;
+        load_catalog(C, cat_path);
+        if (C.entry_count > 0) {
+            std::mt19937_64 rng(spec.seed);
+            std::vector<catalog_entry> keys(lookups);
+            for (auto& k : keys) k = C.entries[rng() % C.entry_count];
+            size_t found = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            for (const auto& k : keys) {
+                auto range = C.find(k.hash, (int)k.type);
+                found += range.second - range.first > 0;
+            }
+            lookup_seconds = seconds_since(t0);
+            if (found != keys.size()) throw std::runtime_error("bench catalog: lookup missed a cataloged resource");
+        }
+    } catch (...) {
+        g_verbose = true;
+        throw;
     }
+    g_verbose = true;
     
-    // Write output
-    fs::path out_path = out_pack.empty() ?
-        (orig_pack.parent_path() / (orig_pack.stem().string() + ".NEW.PCPACK")) : out_pack;
-    
-    if (!out_path.parent_path().empty())
-        fs::create_directories(out_path.parent_path());
-    
-    write_file(out_path, out);
+    if (!keep) {
+        std::error_code ec;
+        fs::remove_all(work_dir, ec);
+    } else {
+        fprintf(stderr, "Bench files kept in %s\n", work_dir.string().c_str());
+    }
     
-    printf("\nImport complete!\n");
-    printf("  Output: %s\n", out_path.string().c_str());
-    printf("  Size: %zu bytes (0x%zX)\n", out.size(), out.size());
+    printf("{\n");
+    printf("  \"packs\": %zu,\n", pack_count);
+    printf("  \"resources_per_pack\": %zu,\n", spec.resources);
+    printf("  \"seed\": %u,\n", spec.seed);
+    printf("  \"jobs\": %u,\n", jobs);
+    printf("  \"pack_bytes\": %llu,\n", (unsigned long long)total_bytes);
+    printf("  \"entries\": %zu,\n", entries);
+    printf("  \"phases\": [\n");
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const auto& ph = phases[i];
+        printf("    { \"name\": \"%s\", \"seconds\": %.6f, \"packs_scanned\": %zu }%s\n",
+               ph.name, ph.seconds, ph.scanned, i + 1 < phases.size() ? "," : "");
+    }
+    printf("  ],\n");
+    printf("  \"lookups\": %zu,\n", lookups);
+    printf("  \"ns_per_lookup\": %.1f\n", lookups ? lookup_seconds * 1e9 / lookups : 0.0);
+    printf("}\n");
+}
+
+// A new, empty pcpack_bench_XXXXXX folder under parent. Benches work and
+// clean up inside it only, so --dir may point at a folder that holds
+// anything else.
+static fs::path bench_work_dir(const fs::path& parent) {
+    fs::create_directories(parent);
+    std::mt19937_64 rng(std::random_device{}() ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        char name[32];
+        snprintf(name, sizeof(name), "pcpack_bench_%06llx", (unsigned long long)(rng() & 0xFFFFFF));
+        fs::path dir = parent / name;
+        if (fs::create_directory(dir)) return dir;
+    }
+    throw std::runtime_error("Cannot create a bench folder in " + parent.string());
+}
+
+// Generated pack options shared by the bench commands
+static SyntheticSpec take_synthetic_spec(std::vector<std::string>& args, const SyntheticSpec& defaults = SyntheticSpec()) {
+    SyntheticSpec spec;
+    spec.resources = std::stoul(take_option(args, "--resources", std::to_string(defaults.resources)));
+    spec.tl_entries = std::stoul(take_option(args, "--tl", std::to_string(spec.resources)));
+    spec.min_size = (uint32_t)std::stoul(take_option(args, "--min-size", std::to_string(defaults.min_size)));
+    spec.max_size = (uint32_t)std::stoul(take_option(args, "--max-size", std::to_string(defaults.max_size)));
+    spec.log_sizes = take_option(args, "--dist", defaults.log_sizes ? "log" : "uniform") != "uniform";
+    spec.seed = (uint32_t)std::stoul(take_option(args, "--seed", std::to_string(defaults.seed)));
+    return spec;
 }
 
 // ==================== Main ====================
@@ -637,14 +3358,145 @@ static void do_import(const fs::path& orig_pack, const fs::path& input_dir,
 static void print_usage() {
     printf("PCPACK Tool - Ultimate Spider-Man (2005) PC\n\n");
     printf("Usage:\n");
-    printf("  pcpack_tool export <input.pcpack> [output_dir] [dictionary.txt]\n");
-    printf("  pcpack_tool import <original.pcpack> <input_dir> <output.pcpack> [--align N]\n");
+    printf("  pcpack_tool export <input.pcpack> [output_dir] [dictionary.txt] [--jobs N]\n");
+    printf("  pcpack_tool import <original.pcpack> <input_dir> <output.pcpack> [--align N] [--dict dictionary.txt]\n");
+    printf("                     [--in-place] [--dedupe] [--layout L] [--small-align N] [--reuse-holes]\n");
+    printf("  pcpack_tool reimport <original.pcpack> <folder> <output.pcpack> [--align N] [--dict dictionary.txt]\n");
+    printf("                       [--dedupe] [--layout L] [--small-align N]\n");
+    printf("  pcpack_tool info <input.pcpack|glob>...\n");
+    printf("  pcpack_tool list <input.pcpack> [dictionary.txt]\n");
+    printf("  pcpack_tool extract <input.pcpack> <name|0xHASH>[.EXT] [-o file|-]\n");
+    printf("  pcpack_tool mount <input.pcpack> <mountpoint> [--dict dictionary.txt] [-f] [-d] [-o opts]\n");
+    printf("  pcpack_tool diffpatch create <old.pcpack> <new.pcpack> <patch.pcpd>\n");
+    printf("  pcpack_tool diffpatch apply <old.pcpack> <patch.pcpd> <output.pcpack>\n");
+    printf("  pcpack_tool catalog build <game_dir> <catalog.pcct> [--jobs N] [--digests]\n");
+    printf("  pcpack_tool catalog find <catalog.pcct> <name|0xHASH>[.EXT]...\n");
+    printf("  pcpack_tool batch <jobs.txt> [--jobs N] [--dict dictionary.txt] [--verbose]\n");
+    printf("  pcpack_tool batch export <pack|glob> [out_root] [--jobs N] [--dict dictionary.txt]\n");
+    printf("  pcpack_tool batch import <pack|glob> <in_root> [out_root] [--jobs N] [--dict dictionary.txt]\n");
+    printf("  pcpack_tool dict compile <dictionary.txt> <dictionary.bin>\n");
+    printf("  pcpack_tool dict verify <dictionary.txt|dictionary.bin> [--jobs N]\n");
+    printf("  pcpack_tool crack <pack|glob>... --dict dictionary.txt [--words list] [--dict-words]\n");
+    printf("                    [--prefixes list] [--suffixes list] [--sep chars] [--combine N]\n");
+    printf("                    [--charset chars] [--min-len N] [--max-len N] [--jobs N]\n");
+    printf("                    [--write] [--out dictionary.txt]\n");
+    printf("  pcpack_tool bench remap [entries]\n");
+    printf("  pcpack_tool bench pack [--resources N] [--tl N] [--min-size B] [--max-size B]\n");
+    printf("                         [--dist log|uniform] [--seed S] [--jobs N] [--dir work_dir] [--keep]\n");
+    printf("  pcpack_tool bench layout [--resources N] [--min-size B] [--max-size B] [--dist log|uniform]\n");
+    printf("                           [--seed S] [--align N] [--small-align N] [--dir work_dir] [--keep]\n");
+    printf("  pcpack_tool bench catalog [--packs N] [--resources N] [--min-size B] [--max-size B]\n");
+    printf("                            [--seed S] [--lookups N] [--jobs N] [--dir work_dir] [--keep]\n");
+    printf("  pcpack_tool bench io [--resources N] [--min-size B] [--max-size B] [--dist log|uniform]\n");
+    printf("                       [--seed S] [--jobs N] [--dir work_dir] [--keep]\n");
     printf("\nExport extracts all resources and creates a manifest file.\n");
     printf("Import rebuilds the PCPACK using files from input_dir, updating all offsets.\n");
+    printf("Reimport also adds files with new names as resources, sorts entries by\n");
+    printf("type then hash and moves base when the directory grows (append layout n/a).\n");
+    printf("Info and list read only the header and directory, never the payloads.\n");
+    printf("Extract copies one resource out by name or hash; -o - writes it to stdout.\n");
+    printf("Mount shows the pack as a read-only folder with export's file names and\n");
+    printf("_manifest.txt, reading payloads only when they are read (needs FUSE;\n");
+    printf("unmount with fusermount3 -u). -f stays in the foreground.\n");
+    printf("Diffpatch stores the new directory and changed payloads only; apply streams\n");
+    printf("the new pack out of the old one (output may be the old pack itself).\n");
+    printf("Catalog build reads the directories of every .PCPACK under game_dir and\n");
+    printf("writes a sorted (hash, type) -> pack, offset, size table; building again\n");
+    printf("only rereads packs whose size or time changed. --digests also stores the\n");
+    printf("XXH64 of every payload (reads the packs fully). Catalog find looks keys up.\n");
+    printf("Batch runs many exports/imports in one process, one pack per thread; a job\n");
+    printf("list holds one 'export ...' or 'import ...' line per job (globs allowed).\n");
+    printf("Dict compile writes a binary dictionary that loads without parsing;\n");
+    printf("it can be passed anywhere a dictionary.txt is accepted. Dict verify checks\n");
+    printf("that every name hashes to its entry and lists the ones that do not.\n");
+    printf("Crack searches names for the hashes the dictionary cannot resolve: words\n");
+    printf("(lists are a file with one entry per line or comma separated), combined\n");
+    printf("words, prefixes/suffixes and brute force over a charset, on all cores.\n");
+    printf("Found names are only printed; --write appends them to the dictionary (or --out).\n");
+    printf("Bench pack times parse/export/import on a generated pack and prints JSON.\n");
+    printf("Bench layout rebuilds a generated pack with every repacking layout\n");
+    printf("(default --align 2048 --small-align 16) and compares size and padding.\n");
+    printf("Bench catalog times catalog builds over many generated packs (default\n");
+    printf("1000 packs of 200 resources) and random lookups.\n");
+    printf("Benches work in a new pcpack_bench_XXXXXX folder under --dir (default: the\n");
+    printf("temp folder) and delete only that folder unless --keep is given.\n");
+    printf("Bench io times export and unchanged import of a pack of many small files\n");
+    printf("(default 20000 of 64..4096 bytes) with standard streams and with io_uring.\n");
     printf("\nOptions:\n");
     printf("  --align N   Align payloads to N bytes (default: 16)\n");
+    printf("  --jobs N    Write exported files / check import files on N threads\n");
+    printf("              (default: 1, 0 = all cores);\n");
+    printf("              for batch, packs processed at once (default: 0)\n");
+    printf("  --dict F    Dictionary used to find named replacement files on import\n");
+    printf("  --in-place  Overwrite only the replaced resources when they fit in their\n");
+    printf("              old slots; output may be the original pack itself\n");
+    printf("  --dedupe    Store identical payloads once (entries the source pack already\n");
+    printf("              shares are always kept shared)\n");
+    printf("  --layout L  original: repack payloads from offset 0 in index order (default)\n");
+    printf("              type-hash: repack sorted by type, then hash\n");
+    printf("              size: repack fully aligned payloads largest first, then small ones\n");
+    printf("              binpack: repack in index order, small payloads filling alignment gaps\n");
+    printf("              append: payloads that fit keep their offsets, grown ones move to\n");
+    printf("              the end; with --in-place only changed bytes are written\n");
+    printf("  --small-align N  Alignment of payloads smaller than --align (default: --align)\n");
+    printf("  --reuse-holes  Append layout: place moved payloads in slots freed by others\n");
+    printf("  --io B      File I/O for export and import: auto (io_uring when the system\n");
+    printf("              has it, default), uring or std\n");
+    printf("  --trace F   Any command: record phase timings (parse, dictionary, names,\n");
+    printf("              layout, TL remap, directory, payload writes...) per thread into\n");
+    printf("              F in Chrome trace format (chrome://tracing, ui.perfetto.dev)\n");
+    printf("  --stats     Any command: print bytes read/written, allocations, peak RSS\n");
+    printf("              and time per phase on exit\n");
 }
 
+// Writes the --trace file and prints the --stats summary (to stderr, so
+// extract -o - stays clean) however the command ends
+struct RunReport {
+    fs::path trace_path;
+    bool stats = false;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    
+    ~RunReport() {
+        if (!trace_path.empty()) {
+            try {
+                write_trace(trace_path);
+                fprintf(stderr, "Trace written to %s\n", trace_path.string().c_str());
+            } catch (const std::exception& e) {
+                fprintf(stderr, "Error: %s\n", e.what());
+            }
+        }
+        if (!stats) return;
+        g_count_allocs.store(false, std::memory_order_relaxed);
+        fflush(stdout);
+        
+        ProcessIo io = process_io();
+        fprintf(stderr, "\nStats:\n");
+        fprintf(stderr, "  Wall time: %.3f s\n", seconds_since(t0));
+        if (io.valid) {
+            fprintf(stderr, "  Read: %llu bytes (%llu from storage)\n",
+                    (unsigned long long)io.read, (unsigned long long)io.storage_read);
+            fprintf(stderr, "  Written: %llu bytes (%llu to storage)\n",
+                    (unsigned long long)io.written, (unsigned long long)io.storage_written);
+        }
+        fprintf(stderr, "  Allocations: %llu (%llu bytes)\n",
+                (unsigned long long)g_allocs.load(), (unsigned long long)g_alloc_bytes.load());
+        fprintf(stderr, "  Peak RSS: %llu KB\n", (unsigned long long)peak_rss_kb());
+        
+        // Phase totals in order of first use; nested phases are part of their parent's time
+        struct Total { const char* name; size_t calls; int64_t us; };
+        std::vector<Total> totals;
+        for (const auto& e : trace_events()) {
+            auto it = std::find_if(totals.begin(), totals.end(), [&](const Total& t) { return strcmp(t.name, e.name) == 0; });
+            if (it == totals.end()) totals.push_back({ e.name, 1, e.dur_us });
+            else { it->calls++; it->us += e.dur_us; }
+        }
+        if (totals.empty()) return;
+        fprintf(stderr, "  %-22s %6s %11s\n", "Phase", "calls", "total ms");
+        for (const auto& t : totals)
+            fprintf(stderr, "    %-20s %6zu %11.3f\n", t.name, t.calls, t.us / 1000.0);
+    }
+};
+
 int main(int argc, char** argv) {
     try {
         if (argc < 3) {
@@ -653,30 +3505,223 @@ int main(int argc, char** argv) {
         }
         
         std::string cmd = argv[1];
+        std::vector<std::string> args(argv + 2, argv + argc);
+        g_io_backend = parse_io_backend(take_option(args, "--io", "auto"));
+        
+        RunReport run_report;
+        run_report.trace_path = take_option(args, "--trace");
+        run_report.stats = take_flag(args, "--stats");
+        if (!run_report.trace_path.empty() || run_report.stats) trace_start();
+        g_count_allocs.store(run_report.stats, std::memory_order_relaxed);
         
         if (cmd == "export") {
-            fs::path pack_path = argv[2];
-            fs::path out_dir = (argc > 3) ? argv[3] : "";
-            fs::path dict_path = (argc > 4) ? argv[4] : "";
-            do_export(pack_path, out_dir, dict_path);
+            unsigned jobs = (unsigned)std::stoul(take_option(args, "--jobs", "1"));
+            if (args.empty()) {
+                print_usage();
+                return 1;
+            }
+            fs::path pack_path = args[0];
+            fs::path out_dir = (args.size() > 1) ? args[1] : "";
+            fs::path dict_path = (args.size() > 2) ? args[2] : "";
+            do_export(pack_path, out_dir, dict_path, jobs);
         }
         else if (cmd == "import") {
-            if (argc < 5) {
+            ImportOptions opt;
+            opt.align = std::stoul(take_option(args, "--align", "16"));
+            opt.in_place = take_flag(args, "--in-place");
+            opt.dedupe = take_flag(args, "--dedupe");
+            opt.layout = parse_layout(take_option(args, "--layout", "original"));
+            opt.reuse_holes = take_flag(args, "--reuse-holes");
+            opt.small_align = std::stoul(take_option(args, "--small-align", "0"));
+            opt.jobs = (unsigned)std::stoul(take_option(args, "--jobs", "1"));
+            fs::path dict_path = take_option(args, "--dict");
+            if (args.size() < 3) {
                 print_usage();
                 return 1;
             }
-            fs::path orig_pack = argv[2];
-            fs::path input_dir = argv[3];
-            fs::path out_pack = argv[4];
+            fs::path orig_pack = args[0];
+            fs::path input_dir = args[1];
+            fs::path out_pack = args[2];
             
-            size_t align_val = 16;
-            for (int i = 5; i < argc - 1; ++i) {
-                if (std::string(argv[i]) == "--align") {
-                    align_val = std::stoul(argv[i + 1]);
+            do_import(orig_pack, input_dir, out_pack, dict_path, opt);
+        }
+        else if (cmd == "reimport") {
+            ImportOptions opt;
+            opt.align = std::stoul(take_option(args, "--align", "16"));
+            opt.dedupe = take_flag(args, "--dedupe");
+            opt.layout = parse_layout(take_option(args, "--layout", "original"));
+            opt.small_align = std::stoul(take_option(args, "--small-align", "0"));
+            fs::path dict_path = take_option(args, "--dict");
+            if (args.size() < 3) {
+                print_usage();
+                return 1;
+            }
+            do_reimport(args[0], args[1], args[2], dict_path, opt);
+        }
+        else if (cmd == "info") {
+            for (const auto& a : args) {
+                for (const auto& pack : expand_glob(a))
+                    do_info(pack);
+            }
+        }
+        else if (cmd == "list") {
+            do_list(args[0], (args.size() > 1) ? args[1] : "");
+        }
+        else if (cmd == "extract") {
+            fs::path out = take_option(args, "-o");
+            if (args.size() < 2) {
+                print_usage();
+                return 1;
+            }
+            do_extract(args[0], args[1], out);
+        }
+        else if (cmd == "diffpatch") {
+            if (args.size() >= 4 && args[0] == "create") {
+                diffpatch_create(args[1], args[2], args[3]);
+            } else if (args.size() >= 4 && args[0] == "apply") {
+                diffpatch_apply(args[1], args[2], args[3]);
+            } else {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (cmd == "catalog") {
+            unsigned jobs = (unsigned)std::stoul(take_option(args, "--jobs", "0"));
+            bool digests = take_flag(args, "--digests");
+            if (args.size() >= 3 && args[0] == "build") {
+                catalog_build(args[1], args[2], jobs, digests);
+            } else if (args.size() >= 3 && args[0] == "find") {
+                if (catalog_find(args[1], std::vector<std::string>(args.begin() + 2, args.end())) > 0)
+                    return 1;
+            } else {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (cmd == "mount") {
+            fs::path dict_path = take_option(args, "--dict");
+            std::string options = take_option(args, "-o");
+            bool foreground = take_flag(args, "-f");
+            bool debug = take_flag(args, "-d");
+            if (args.size() < 2) {
+                print_usage();
+                return 1;
+            }
+#ifdef PCPACK_WITH_FUSE
+            std::vector<std::string> fuse_args;
+            if (foreground) fuse_args.push_back("-f");
+            if (debug) fuse_args.push_back("-d");
+            if (!options.empty()) fuse_args.insert(fuse_args.end(), { "-o", options });
+            return do_mount(args[0], args[1], dict_path, fuse_args);
+#else
+            (void)foreground;
+            (void)debug;
+            throw std::runtime_error("mount needs FUSE: build with -DPCPACK_WITH_FUSE=ON (libfuse3)");
+#endif
+        }
+        else if (cmd == "batch") {
+            unsigned jobs = (unsigned)std::stoul(take_option(args, "--jobs", "0"));
+            fs::path dict_path = take_option(args, "--dict");
+            bool verbose = take_flag(args, "--verbose");
+            if (args.empty()) {
+                print_usage();
+                return 1;
+            }
+            std::vector<BatchJob> batch;
+            if (args[0] == "export" || args[0] == "import") {
+                add_batch_jobs(batch, args);
+            } else {
+                std::ifstream list(args[0]);
+                if (!list) throw std::runtime_error("Cannot open: " + args[0]);
+                std::string line;
+                while (std::getline(list, line)) {
+                    std::vector<std::string> tok = split_job_line(line);
+                    if (!tok.empty()) add_batch_jobs(batch, tok);
                 }
             }
-            
-            do_import(orig_pack, input_dir, out_pack, align_val);
+            if (run_batch(batch, dict_path, jobs, verbose) > 0)
+                return 1;
+        }
+        else if (cmd == "crack") {
+            CrackOptions opt;
+            fs::path dict_path = take_option(args, "--dict");
+            fs::path out_path = take_option(args, "--out");
+            std::string words = take_option(args, "--words");
+            if (!words.empty()) opt.words = read_crack_list(words);
+            opt.dict_words = take_flag(args, "--dict-words");
+            std::string prefixes = take_option(args, "--prefixes");
+            if (!prefixes.empty()) opt.prefixes = read_crack_list(prefixes);
+            std::string suffixes = take_option(args, "--suffixes");
+            if (!suffixes.empty()) opt.suffixes = read_crack_list(suffixes);
+            opt.separators = take_option(args, "--sep");
+            opt.combine = std::stoul(take_option(args, "--combine", "1"));
+            opt.min_len = std::stoul(take_option(args, "--min-len", "1"));
+            opt.max_len = std::stoul(take_option(args, "--max-len", "0"));
+            opt.charset = take_option(args, "--charset", opt.max_len ? "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_" : "");
+            opt.jobs = (unsigned)std::stoul(take_option(args, "--jobs", "0"));
+            bool write = take_flag(args, "--write") || !out_path.empty();
+            if (args.empty()) {
+                print_usage();
+                return 1;
+            }
+            std::vector<fs::path> packs;
+            for (const auto& a : args) {
+                for (const auto& pack : expand_glob(a)) packs.push_back(pack);
+            }
+            do_crack(packs, dict_path, opt, out_path, write);
+        }
+        else if (cmd == "dict") {
+            unsigned jobs = (unsigned)std::stoul(take_option(args, "--jobs", "0"));
+            if (args[0] == "compile" && args.size() >= 3) {
+                compile_hash_dictionary(args[1], args[2]);
+            } else if (args[0] == "verify" && args.size() >= 2) {
+                if (verify_hash_dictionary(args[1], jobs) > 0)
+                    return 1;
+            } else {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (cmd == "bench") {
+            if (args[0] == "remap") {
+                bench_remap((args.size() > 1) ? std::stoul(args[1]) : 60000);
+            }
+            else if (args[0] == "pack") {
+                SyntheticSpec spec = take_synthetic_spec(args);
+                unsigned jobs = (unsigned)std::stoul(take_option(args, "--jobs", "1"));
+                fs::path dir = bench_work_dir(take_option(args, "--dir", fs::temp_directory_path().string()));
+                bench_pack(spec, dir, jobs, take_flag(args, "--keep"));
+            }
+            else if (args[0] == "layout") {
+                SyntheticSpec spec = take_synthetic_spec(args);
+                size_t align = std::stoul(take_option(args, "--align", "2048"));
+                size_t small_align = std::stoul(take_option(args, "--small-align", "16"));
+                fs::path dir = bench_work_dir(take_option(args, "--dir", fs::temp_directory_path().string()));
+                bench_layout(spec, dir, align, small_align, take_flag(args, "--keep"));
+            }
+            else if (args[0] == "catalog") {
+                SyntheticSpec defaults;
+                defaults.resources = 200;
+                defaults.max_size = 4096;
+                SyntheticSpec spec = take_synthetic_spec(args, defaults);
+                size_t packs = std::stoul(take_option(args, "--packs", "1000"));
+                size_t lookups = std::stoul(take_option(args, "--lookups", "1000000"));
+                unsigned jobs = (unsigned)std::stoul(take_option(args, "--jobs", "0"));
+                fs::path dir = bench_work_dir(take_option(args, "--dir", fs::temp_directory_path().string()));
+                bench_catalog(spec, packs, lookups, dir, jobs, take_flag(args, "--keep"));
+            }
+            else if (args[0] == "io") {
+                SyntheticSpec defaults;
+                defaults.resources = 20000;
+                defaults.max_size = 4096;
+                SyntheticSpec spec = take_synthetic_spec(args, defaults);
+                unsigned jobs = (unsigned)std::stoul(take_option(args, "--jobs", "1"));
+                fs::path dir = bench_work_dir(take_option(args, "--dir", fs::temp_directory_path().string()));
+                bench_io(spec, dir, jobs, take_flag(args, "--keep"));
+            } else {
+                print_usage();
+                return 1;
+            }
         }
         else {
             print_usage();
@@ -689,4 +3734,4 @@ int main(int argc, char** argv) {
         fprintf(stderr, "Error: %s\n", e.what());
         return 1;
     }
-}
\ No newline at end of file
+}
@@ -4,15 +4,15 @@
 // common dialogs, status bar, drag-and-drop.
 //
 // Build (MinGW):
-//   g++ -std=c++17 -O2 -DUNICODE -D_UNICODE pcpacktool_gui.cpp -o pcpacktool_gui.exe ^
+//   g++ -std=c++17 -O2 -DUNICODE -D_UNICODE pcpacktool_gui.cpp ../libpcpack/pcpack.cpp -o pcpacktool_gui.exe ^
 //       -lgdi32 -lcomctl32 -lcomdlg32 -lshell32 -ldwmapi -luxtheme -lole32 -mwindows
 //
 // Build (MSVC):
-//   cl /std:c++17 /O2 /DUNICODE /D_UNICODE pcpacktool_gui.cpp ^
+//   cl /std:c++17 /O2 /DUNICODE /D_UNICODE pcpacktool_gui.cpp ..\libpcpack\pcpack.cpp ^
 //      gdi32.lib comctl32.lib comdlg32.lib shell32.lib dwmapi.lib uxtheme.lib ole32.lib ^
 //      user32.lib /link /SUBSYSTEM:WINDOWS
 //
-// Or use the provided CMakeLists.txt.
+// Or use the CMakeLists.txt in the repository root.
 
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "comdlg32.lib")
@@ -43,7 +43,10 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <string_view>
+#include <array>
 #include <vector>
+#include <map>
 #include <unordered_map>
 #include <fstream>
 #include <sstream>
@@ -52,112 +55,14 @@
 #include <stdexcept>
 #include <memory>
 
-namespace fs = std::filesystem;
+#include "../libpcpack/pcpack.h"
 
-// ============================================================================
-//  PCPACK Structures
-// ============================================================================
-
-#pragma pack(push, 1)
-
-struct resource_versions {
-    uint32_t field_0, field_4, field_8, field_C, field_10;
-};
-static_assert(sizeof(resource_versions) == 0x14, "");
-
-struct resource_pack_header {
-    resource_versions field_0;
-    uint32_t          field_14;
-    uint32_t          directory_offset;
-    uint32_t          res_dir_mash_size; // base for payload
-    uint32_t          field_20;
-    uint32_t          field_24;
-    uint32_t          field_28;
-};
-static_assert(sizeof(resource_pack_header) == 0x2C, "");
-
-struct generic_mash_header {
-    int32_t safety_key;
-    int32_t field_4;
-    int32_t field_8;
-    int16_t class_id;
-    int16_t field_E;
-};
-static_assert(sizeof(generic_mash_header) == 0x10, "");
-
-struct string_hash { uint32_t source_hash_code; };
-struct resource_key { string_hash m_hash; uint32_t m_type; };
-
-struct resource_location {
-    resource_key field_0;
-    uint32_t     m_offset;
-    uint32_t     m_size;
-};
-static_assert(sizeof(resource_location) == 0x10, "");
-
-template<typename T>
-struct mashable_vector_t {
-    uint32_t m_data;
-    uint16_t m_size;
-    uint8_t  m_shared;
-    uint8_t  field_7;
-};
-static_assert(sizeof(mashable_vector_t<uint32_t>) == 8, "");
-
-struct tlresource_location {
-    string_hash name;
-    uint8_t     type;
-    uint8_t     pad[3];
-    uint32_t    offset;
-};
-static_assert(sizeof(tlresource_location) == 0x0C, "");
-
-struct resource_directory {
-    mashable_vector_t<int32_t>             parents;
-    mashable_vector_t<resource_location>   resource_locations;
-    mashable_vector_t<tlresource_location> texture_locations;
-    mashable_vector_t<tlresource_location> mesh_file_locations;
-    mashable_vector_t<tlresource_location> mesh_locations;
-    mashable_vector_t<tlresource_location> morph_file_locations;
-    mashable_vector_t<tlresource_location> morph_locations;
-    mashable_vector_t<tlresource_location> material_file_locations;
-    mashable_vector_t<tlresource_location> material_locations;
-    mashable_vector_t<tlresource_location> anim_file_locations;
-    mashable_vector_t<tlresource_location> anim_locations;
-    mashable_vector_t<tlresource_location> scene_anim_locations;
-    mashable_vector_t<tlresource_location> skeleton_locations;
-    mashable_vector_t<int32_t>             field_68;
-    mashable_vector_t<int32_t>             field_70;
-    int32_t pack_slot;
-    int32_t base;
-    int32_t field_80;
-    int32_t field_84;
-    int32_t field_88;
-    int32_t type_start_idxs[70];
-    int32_t type_end_idxs[70];
-};
-static_assert(sizeof(resource_directory) == 0x2BC, "");
-
-#pragma pack(pop)
+using namespace pcpack;
 
 // ============================================================================
-//  Type Extension Table
+//  Type Colors
 // ============================================================================
 
-static const char* resource_type_ext[] = {
-    ".NONE",".PCANIM",".PCSKEL",".ALS",".ENT",".ENTEXT",".DDS",".DDSMP",
-    ".IFL",".DESC",".ENS",".SPL",".AB",".QP",".TRIG",".PCSX",".INST",
-    ".FDF",".PANEL",".TXT",".ICN",".PCMESH",".PCMORPH",".PCMAT",".COLL",
-    ".PCPACK",".PCSANIM",".MSN",".MARKER",".HH",".WAV",".WBK",".M2V",
-    "M2V",".PFX",".CSV",".CLE",".LIT",".GRD",".GLS",".LOD",".SIN",
-    ".GV",".SV",".TOKENS",".DSG",".PATH",".PTRL",".LANG",".SLF",
-    ".VISEME",".PCMESHDEF",".PCMORPHDEF",".PCMATDEF",".MUT",".ASG",
-    ".BAI",".CUT",".INTERACT",".CSV",".CSV","._ENTID_","._ANIMID_",
-    "._REGIONID_","._AI_GENERIC_ID_","._RADIOMSG_","._GOAL_",
-    "._IFC_ATTRIBUTE_","._SIGNAL_","._PACKGROUP_"
-};
-static constexpr int NUM_RESOURCE_TYPES = sizeof(resource_type_ext) / sizeof(resource_type_ext[0]);
-
 static COLORREF get_type_color(const char* ext) {
     if (strcmp(ext, ".DDS") == 0 || strcmp(ext, ".DDSMP") == 0)   return RGB(232, 164, 74);
     if (strcmp(ext, ".PCMESH") == 0 || strcmp(ext, ".PCMESHDEF") == 0) return RGB(74, 232, 138);
@@ -176,9 +81,6 @@ static COLORREF get_type_color(const char* ext) {
 //  Helpers
 // ============================================================================
 
-static std::unordered_map<uint32_t, std::string> g_hashDict;      // hash -> name
-static std::unordered_map<std::string, uint32_t> g_nameToHash;    // name -> hash (reverse)
-
 static std::string to_upper(std::string s) {
     std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return (char)std::toupper(c); });
     return s;
@@ -188,50 +90,32 @@ static std::string to_lower(std::string s) {
     return s;
 }
 
+static HashDictionary g_hashDict;                                  // hash -> name
+static std::unordered_map<std::string, uint32_t> g_nameHashExceptions;   // lower-case name -> hash
+static bool g_nameHashExceptionsBuilt = false;
+
+// Accepts either the text dictionary or a file written by `dict compile`
 static void load_hash_dictionary(const fs::path& path) {
     if (path.empty() || !fs::exists(path)) return;
-    g_hashDict.clear();
-    g_nameToHash.clear();
-
-    std::ifstream f(path);
-    if (!f) return;
-
-    std::string line;
-    while (std::getline(f, line)) {
-        if (line.empty()) continue;
-        std::istringstream iss(line);
-        std::string hex_str, name;
-        if (!(iss >> hex_str >> name)) continue;
-
-        if (hex_str.size() >= 2 && hex_str[0] == '0' && (hex_str[1] == 'x' || hex_str[1] == 'X')) {
-            uint32_t v = (uint32_t)std::stoul(hex_str, nullptr, 16);
-            g_hashDict[v] = name;
-
-            // reverse lookup (case-insensitive)
-            g_nameToHash[name] = v;
-            std::string lower = to_lower(name);
-            g_nameToHash[lower] = v;
-        }
-    }
+    g_hashDict = HashDictionary();
+    g_nameHashExceptions.clear();
+    g_nameHashExceptionsBuilt = false;
+    load_dictionary(g_hashDict, path);
 }
 
-static const char* get_ext(uint32_t type) {
-    return (type < (uint32_t)NUM_RESOURCE_TYPES) ? resource_type_ext[type] : ".UNK";
+// Names map back to hashes through hash_string; only the few dictionary
+// entries whose stored hash is not the hash of their name need a table. It is
+// built on first use, when importing from a folder.
+static const std::unordered_map<std::string, uint32_t>& name_hash_exceptions() {
+    if (!g_nameHashExceptionsBuilt) {
+        g_nameHashExceptions = pcpack::name_hash_exceptions(g_hashDict);
+        g_nameHashExceptionsBuilt = true;
+    }
+    return g_nameHashExceptions;
 }
 
 static std::string get_filename(uint32_t hash, uint32_t type) {
-    auto it = g_hashDict.find(hash);
-    char hex[16]; snprintf(hex, sizeof(hex), "0x%08X", hash);
-    return ((it != g_hashDict.end()) ? it->second : std::string(hex)) + get_ext(type);
-}
-
-static std::string sanitize_filename(const std::string& name) {
-    std::string r = name;
-    for (char& c : r) {
-        if (c < 32 || c == ':' || c == '*' || c == '?' || c == '"' ||
-            c == '<' || c == '>' || c == '|' || c == '/' || c == '\\') c = '_';
-    }
-    return r;
+    return resource_filename(g_hashDict, hash, type);
 }
 
 static std::vector<uint8_t> read_file(const fs::path& path) {
@@ -245,18 +129,6 @@ static std::vector<uint8_t> read_file(const fs::path& path) {
     return data;
 }
 
-static void write_file(const fs::path& path, const std::vector<uint8_t>& data) {
-    std::ofstream f(path, std::ios::binary);
-    if (!f) throw std::runtime_error("Cannot write: " + path.string());
-    if (!data.empty()) f.write((const char*)data.data(), data.size());
-}
-
-static size_t align_up(size_t x, size_t a) {
-    if (a <= 1) return x;
-    size_t m = x % a;
-    return m ? x + (a - m) : x;
-}
-
 static std::string format_size(uint64_t bytes) {
     char buf[64];
     if (bytes < 1024) snprintf(buf, sizeof(buf), "%llu B", (unsigned long long)bytes);
@@ -270,66 +142,6 @@ static std::string format_hex(uint32_t v) {
     return buf;
 }
 
-static int type_from_ext_ci(const std::string& ext) {
-    std::string u = to_upper(ext);
-    for (int i = 0; i < NUM_RESOURCE_TYPES; ++i) {
-        std::string te = resource_type_ext[i] ? resource_type_ext[i] : "";
-        if (to_upper(te) == u) return i;
-    }
-    return -1;
-}
-
-struct ParsedName {
-    bool ok = false;
-    uint32_t hash = 0;
-    uint32_t type = 0;
-};
-
-static ParsedName parse_folder_filename(const fs::path& p) {
-    ParsedName r;
-    std::string ext = p.extension().string();
-    int t = type_from_ext_ci(ext);
-    if (t < 0) return r;
-
-    std::string stem = p.stem().string();
-
-    // allow "0x12345678"
-    if (stem.size() >= 2 && stem[0] == '0' && (stem[1] == 'x' || stem[1] == 'X')) {
-        try {
-            r.hash = (uint32_t)std::stoul(stem, nullptr, 16);
-            r.type = (uint32_t)t;
-            r.ok = true;
-            return r;
-        } catch (...) {
-            return r;
-        }
-    }
-
-    // dictionary name -> hash (case-insensitive)
-    {
-        auto it = g_nameToHash.find(stem);
-        if (it != g_nameToHash.end()) {
-            r.hash = it->second;
-            r.type = (uint32_t)t;
-            r.ok = true;
-            return r;
-        }
-        std::string lower = to_lower(stem);
-        it = g_nameToHash.find(lower);
-        if (it != g_nameToHash.end()) {
-            r.hash = it->second;
-            r.type = (uint32_t)t;
-            r.ok = true;
-            return r;
-        }
-    }
-    return r;
-}
-
-static uint64_t make_key(uint32_t hash, uint32_t type) {
-    return (uint64_t(type) << 32) | uint64_t(hash);
-}
-
 // ============================================================================
 //  Parse PCPACK
 // ============================================================================
@@ -340,79 +152,28 @@ struct ResourceEntry {
     uint32_t    type;
     uint32_t    offset;
     uint32_t    size;
-    std::string filename;
+    mutable std::string filename;   // resolved on first use, see entry_filename()
     std::string ext;
 };
 
-struct ParsedPack {
-    std::vector<uint8_t> raw;
-    std::string source_path;
-
-    resource_pack_header pack_header;
-    generic_mash_header  mash_header;
-    resource_directory   dir;
-
-    std::vector<int32_t>             parents;
-    std::vector<resource_location>   res_locs;
-    std::vector<tlresource_location> textures, mesh_files, meshes;
-    std::vector<tlresource_location> morph_files, morphs;
-    std::vector<tlresource_location> material_files, materials;
-    std::vector<tlresource_location> anim_files, anims;
-    std::vector<tlresource_location> scene_anims, skeletons;
+// Names are resolved when an entry is first shown, searched or exported, so
+// opening a pack does not look up every resource in the dictionary.
+static const std::string& entry_filename(const ResourceEntry& e) {
+    if (e.filename.empty()) e.filename = sanitize_filename(get_filename(e.hash, e.type));
+    return e.filename;
+}
 
+// An open pack: the library's parsed pack plus the list the views show
+struct LoadedPack : ParsedPack {
+    std::string source_path;
     std::vector<ResourceEntry> entries;
-    uint32_t base() const { return pack_header.res_dir_mash_size; }
 };
 
-static ParsedPack parse_pcpack(const fs::path& path) {
-    ParsedPack P;
-    P.raw = read_file(path);
+static LoadedPack load_pack(const fs::path& path) {
+    LoadedPack P;
+    static_cast<ParsedPack&>(P) = parse_pcpack(path);
     P.source_path = path.string();
 
-    if (P.raw.size() < sizeof(resource_pack_header))
-        throw std::runtime_error("File too small");
-
-    memcpy(&P.pack_header, P.raw.data(), sizeof(P.pack_header));
-    uint32_t dir_off = P.pack_header.directory_offset;
-    if (dir_off + sizeof(generic_mash_header) + sizeof(resource_directory) > P.raw.size())
-        throw std::runtime_error("Invalid directory offset");
-
-    memcpy(&P.mash_header, &P.raw[dir_off], sizeof(P.mash_header));
-    memcpy(&P.dir, &P.raw[dir_off + sizeof(generic_mash_header)], sizeof(P.dir));
-
-    size_t pos = dir_off + sizeof(generic_mash_header) + sizeof(resource_directory);
-    auto ra = [&]() { pos = align_up(pos, 8); pos = align_up(pos, 4); };
-
-    auto ri32 = [&](uint16_t n) {
-        ra(); std::vector<int32_t> v(n);
-        if (n) { memcpy(v.data(), &P.raw[pos], n * 4); pos += n * 4; }
-        pos = align_up(pos, 4); return v;
-    };
-    auto rrl = [&](uint16_t n) {
-        ra(); std::vector<resource_location> v(n);
-        if (n) { memcpy(v.data(), &P.raw[pos], n * sizeof(resource_location)); pos += n * sizeof(resource_location); }
-        pos = align_up(pos, 4); return v;
-    };
-    auto rtl = [&](uint16_t n) {
-        ra(); std::vector<tlresource_location> v(n);
-        if (n) { memcpy(v.data(), &P.raw[pos], n * sizeof(tlresource_location)); pos += n * sizeof(tlresource_location); }
-        pos = align_up(pos, 4); return v;
-    };
-
-    P.parents        = ri32(P.dir.parents.m_size);
-    P.res_locs       = rrl(P.dir.resource_locations.m_size);
-    P.textures       = rtl(P.dir.texture_locations.m_size);
-    P.mesh_files     = rtl(P.dir.mesh_file_locations.m_size);
-    P.meshes         = rtl(P.dir.mesh_locations.m_size);
-    P.morph_files    = rtl(P.dir.morph_file_locations.m_size);
-    P.morphs         = rtl(P.dir.morph_locations.m_size);
-    P.material_files = rtl(P.dir.material_file_locations.m_size);
-    P.materials      = rtl(P.dir.material_locations.m_size);
-    P.anim_files     = rtl(P.dir.anim_file_locations.m_size);
-    P.anims          = rtl(P.dir.anim_locations.m_size);
-    P.scene_anims    = rtl(P.dir.scene_anim_locations.m_size);
-    P.skeletons      = rtl(P.dir.skeleton_locations.m_size);
-
     P.entries.resize(P.res_locs.size());
     for (size_t i = 0; i < P.res_locs.size(); ++i) {
         auto& e = P.entries[i];
@@ -422,32 +183,52 @@ static ParsedPack parse_pcpack(const fs::path& path) {
         e.type = rl.field_0.m_type;
         e.offset = rl.m_offset;
         e.size = rl.m_size;
-        e.filename = sanitize_filename(get_filename(e.hash, e.type));
         e.ext = get_ext(e.type);
     }
     return P;
 }
 
+// Index of the resource a file in an export folder belongs to, or -1. With
+// duplicate keys the first entry takes the file, as with the filename scan.
+static int find_by_filename(const ParsedPack& P, const fs::path& file) {
+    ParsedName pn = parse_folder_filename(file, &name_hash_exceptions());
+    return pn.ok ? P.find_first(pn.hash, pn.type) : -1;
+}
+
+// True when file holds exactly the payload of resource index
+static bool same_as_payload(const ParsedPack& P, size_t index, const fs::path& file) {
+    const auto& rl = P.res_locs[index];
+    std::error_code ec;
+    if (fs::file_size(file, ec) != rl.m_size || ec) return false;
+    if ((uint64_t)P.base() + rl.m_offset + rl.m_size > P.raw.size()) return false;
+    ByteSpan payload = P.payload(index);
+    std::vector<char> buf(1 << 20);
+    return xxh64_file(file, buf) == xxh64(payload.data, payload.size);
+}
+
 // ============================================================================
 //  Export
 // ============================================================================
 
-static void do_export_all(const ParsedPack& P, const fs::path& out_dir) {
+static void do_export_all(const LoadedPack& P, const fs::path& out_dir) {
     fs::create_directories(out_dir);
     std::ofstream manifest(out_dir / "_manifest.txt");
-    manifest << "# PCPACK Manifest\n# base=" << P.base() << "\n# resources=" << P.res_locs.size() << "\n\n";
+    manifest << "# PCPACK Manifest\n# base=" << P.base() << "\n# resources=" << P.res_locs.size()
+             << "\n# index hash type offset size xxh64 filename\n\n";
 
     for (size_t i = 0; i < P.res_locs.size(); ++i) {
         const auto& rl = P.res_locs[i];
         uint64_t start = (uint64_t)P.base() + rl.m_offset;
         uint64_t end = start + rl.m_size;
         if (end > P.raw.size()) continue;
-        std::ofstream of(out_dir / P.entries[i].filename, std::ios::binary);
+        std::ofstream of(out_dir / entry_filename(P.entries[i]), std::ios::binary);
         if (of) of.write((const char*)&P.raw[start], rl.m_size);
+        char digest[17];
+        snprintf(digest, sizeof(digest), "%016llx", (unsigned long long)xxh64(&P.raw[start], rl.m_size));
         manifest << i << " 0x" << std::hex << rl.field_0.m_hash.source_hash_code
                  << " " << std::dec << rl.field_0.m_type
                  << " 0x" << std::hex << rl.m_offset << " 0x" << rl.m_size
-                 << " " << P.entries[i].filename << "\n";
+                 << " " << digest << " " << entry_filename(P.entries[i]) << std::dec << "\n";
     }
 }
 
@@ -464,434 +245,87 @@ static void do_export_single(const ParsedPack& P, int index, const fs::path& out
 //  Import / Rebuild (replace existing by index)
 // ============================================================================
 
-static std::vector<uint8_t> do_import(
+// Plans the chosen layout and logs the padding it saves over index order
+static std::vector<uint32_t> layout_offsets(const std::vector<LayoutItem>& items, const std::vector<int>& shared_with,
+                                            const LayoutOptions& lay, std::string* out_log) {
+    LayoutPlan plan = plan_payload_layout(items, shared_with, lay.layout, lay.align, lay.small_align);
+    if (out_log && (lay.layout != LAYOUT_ORIGINAL || lay.small_align != 0)) {
+        LayoutPlan ref = plan_payload_layout(items, shared_with, LAYOUT_ORIGINAL, lay.align, lay.align);
+        *out_log += "Layout " + std::string(layout_names[lay.layout]) + ": " + std::to_string(plan.padding) +
+            " bytes of padding, " + std::to_string((long long)ref.padding - (long long)plan.padding) +
+            " saved against original order\r\n";
+    }
+    return plan.offsets;
+}
+
+// Writes P with the queued replacements to out_path and returns its size.
+// Kept payloads are copied from the source mapping, never loaded.
+static uint64_t do_import(
     ParsedPack& P,
     const std::unordered_map<int, std::vector<uint8_t>>& replacements,
-    size_t align_val)
+    const LayoutOptions& lay,
+    bool dedupe,
+    const fs::path& out_path,
+    std::string* out_log = nullptr)
 {
-    struct NR { uint32_t new_offset, new_size; std::vector<uint8_t> data; };
-    std::vector<NR> nres(P.res_locs.size());
-
-    uint32_t cursor = 0;
+    std::vector<PayloadSource> payloads(P.res_locs.size());
     for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        const auto& rl = P.res_locs[i];
         auto it = replacements.find((int)i);
-        if (it != replacements.end()) {
-            nres[i].data = it->second;
-            nres[i].new_size = (uint32_t)it->second.size();
-        } else {
-            uint64_t s = (uint64_t)P.base() + rl.m_offset;
-            nres[i].data.assign(&P.raw[s], &P.raw[s] + rl.m_size);
-            nres[i].new_size = rl.m_size;
+        if (it == replacements.end()) {
+            payloads[i] = kept_payload(P, i);
+            continue;
         }
-        cursor = (uint32_t)align_up(cursor, align_val);
-        nres[i].new_offset = cursor;
-        cursor += nres[i].new_size;
+        payloads[i].bytes = { it->second.data(), it->second.size() };
+        payloads[i].size = it->second.size();
     }
 
-    auto utl = [&](uint32_t old_off) -> uint32_t {
-        for (size_t i = 0; i < P.res_locs.size(); ++i) {
-            uint32_t rs = P.res_locs[i].m_offset, re = rs + P.res_locs[i].m_size;
-            if (old_off >= rs && old_off < re)
-                return nres[i].new_offset + (old_off - rs);
-        }
-        return old_off;
-    };
-    auto uv = [&](std::vector<tlresource_location>& v) { for (auto& t : v) t.offset = utl(t.offset); };
+    // Shared payloads take the offset of their first entry and are stored once
+    SharedPayloads shared = find_shared_payloads(payloads, dedupe);
+    std::vector<LayoutItem> items(payloads.size());
+    for (size_t i = 0; i < payloads.size(); ++i)
+        items[i] = { (uint32_t)payloads[i].size, P.res_locs[i].field_0.m_type, P.res_locs[i].field_0.m_hash.source_hash_code };
+    std::vector<uint32_t> offsets = layout_offsets(items, shared.with, lay, out_log);
 
-    uv(P.textures); uv(P.mesh_files); uv(P.meshes);
-    uv(P.morph_files); uv(P.morphs);
-    uv(P.material_files); uv(P.materials);
-    uv(P.anim_files); uv(P.anims);
-    uv(P.scene_anims); uv(P.skeletons);
+    OffsetRemap remap;
+    for (size_t i = 0; i < P.res_locs.size(); ++i)
+        remap.add(P.res_locs[i].m_offset, P.res_locs[i].m_size, offsets[i]);
+    remap.finish();
+    update_tl_offsets(P, remap);
 
     for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        P.res_locs[i].m_offset = nres[i].new_offset;
-        P.res_locs[i].m_size = nres[i].new_size;
+        P.res_locs[i].m_offset = offsets[i];
+        P.res_locs[i].m_size = (uint32_t)payloads[i].size;
     }
-
-    std::vector<uint8_t> out;
-    out.resize(sizeof(resource_pack_header));
-    memcpy(out.data(), &P.pack_header, sizeof(P.pack_header));
-    if (out.size() < P.pack_header.directory_offset) out.resize(P.pack_header.directory_offset, 0);
-    out.insert(out.end(), (uint8_t*)&P.mash_header, (uint8_t*)&P.mash_header + sizeof(P.mash_header));
-    out.insert(out.end(), (uint8_t*)&P.dir, (uint8_t*)&P.dir + sizeof(P.dir));
-
-    auto ea = [&](size_t a, uint8_t f = 0xE3) {
-        size_t w = align_up(out.size(), a);
-        if (w > out.size()) out.insert(out.end(), w - out.size(), f);
-    };
-    auto ei = [&](const std::vector<int32_t>& v) {
-        ea(8); ea(4);
-        if (!v.empty()) { auto* p = (const uint8_t*)v.data(); out.insert(out.end(), p, p + v.size() * 4); }
-        ea(4);
-    };
-    auto er = [&](const std::vector<resource_location>& v) {
-        ea(8); ea(4);
-        if (!v.empty()) { auto* p = (const uint8_t*)v.data(); out.insert(out.end(), p, p + v.size() * sizeof(resource_location)); }
-        ea(4);
-    };
-    auto et = [&](const std::vector<tlresource_location>& v) {
-        ea(8); ea(4);
-        if (!v.empty()) { auto* p = (const uint8_t*)v.data(); out.insert(out.end(), p, p + v.size() * sizeof(tlresource_location)); }
-        ea(4);
-    };
-
-    ei(P.parents); er(P.res_locs);
-    et(P.textures); et(P.mesh_files); et(P.meshes);
-    et(P.morph_files); et(P.morphs);
-    et(P.material_files); et(P.materials);
-    et(P.anim_files); et(P.anims);
-    et(P.scene_anims); et(P.skeletons);
-
-    if (out.size() < P.base()) out.resize(P.base(), 0xE3);
-
-    for (size_t i = 0; i < nres.size(); ++i) {
-        size_t s = (size_t)P.base() + nres[i].new_offset;
-        if (out.size() < s + nres[i].new_size) out.resize(s + nres[i].new_size, 0);
-        if (nres[i].new_size)
-            memcpy(&out[s], nres[i].data.data(), nres[i].new_size);
-    }
-    return out;
+    return write_pack(out_path, P, payloads, shared.with).size;
 }
 
 // ============================================================================
 //  Reimport (Folder Sync + Add New + Reorder by type then hash)
 // ============================================================================
-//  Reimport (Folder Sync + Add New + Reorder by type then hash)
-//   - NEW: also adds TL entries for newly added resources (when applicable)
-//   - NEW: patches pack header res_dir_mash_size (+ directory_offset safety)
+//   - adds TL entries for newly added resources (when applicable)
+//   - moves base (res_dir_mash_size and the directory copy) with the directory
 // ============================================================================
 
-static std::vector<uint8_t> do_reimport_from_folder(
+static uint64_t do_reimport_from_folder(
     ParsedPack& P,
     const fs::path& folder,
-    size_t align_val,
+    const LayoutOptions& lay,
+    bool dedupe,
+    const fs::path& out_path,
     std::string* out_log)
 {
-    if (!fs::exists(folder) || !fs::is_directory(folder))
-        throw std::runtime_error("Reimport folder does not exist or is not a directory.");
-
-    struct OldRes { uint32_t old_off, old_size; };
-    std::vector<OldRes> old(P.res_locs.size());
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        old[i].old_off = P.res_locs[i].m_offset;
-        old[i].old_size = P.res_locs[i].m_size;
-    }
-
-    std::unordered_map<uint64_t, int> key_to_index;
-    key_to_index.reserve(P.res_locs.size() * 2);
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        uint32_t h = P.res_locs[i].field_0.m_hash.source_hash_code;
-        uint32_t t = P.res_locs[i].field_0.m_type;
-        key_to_index[make_key(h, t)] = (int)i;
-    }
-
-    struct Item {
-        uint32_t hash = 0;
-        uint32_t type = 0;
-        std::vector<uint8_t> data;
-        bool has_old = false;
-        uint32_t old_off = 0;
-        uint32_t old_size = 0;
-    };
-
-    std::vector<Item> items;
-    items.reserve(P.res_locs.size() + 256);
-
-    // Seed from old pack (keeps old_off/old_size for TL remap)
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        Item it;
-        it.hash = P.res_locs[i].field_0.m_hash.source_hash_code;
-        it.type = P.res_locs[i].field_0.m_type;
-        it.has_old = true;
-        it.old_off = old[i].old_off;
-        it.old_size = old[i].old_size;
-
-        uint64_t s = (uint64_t)P.base() + old[i].old_off;
-        uint64_t e = s + old[i].old_size;
-        if (e > P.raw.size()) throw std::runtime_error("Corrupted pack: resource out of bounds.");
-        it.data.assign(&P.raw[s], &P.raw[s] + old[i].old_size);
-        items.push_back(std::move(it));
+    ReimportResult r = plan_reimport(P, folder, name_hash_exceptions(), lay, dedupe);
+
+    if (out_log) {
+        *out_log += "Reimport folder: " + folder.string() + "\r\n";
+        *out_log += "Updated: " + std::to_string(r.updated) + ", Unchanged: " + std::to_string(r.unchanged) +
+            ", Added: " + std::to_string(r.added) + ", Skipped: " + std::to_string(r.skipped) + "\r\n";
+        if (lay.layout != LAYOUT_ORIGINAL || lay.small_align != 0)
+            *out_log += "Layout " + std::string(layout_names[lay.layout]) + ": " + std::to_string(r.padding) +
+                " bytes of padding, " + std::to_string((long long)r.original_padding - (long long)r.padding) +
+                " saved against original order\r\n";
     }
-
-    auto log_append = [&](const std::string& s) {
-        if (out_log) { *out_log += s; *out_log += "\r\n"; }
-        };
-
-    int updated = 0, added = 0, skipped = 0;
-
-    // Apply folder changes (update existing, add new)
-    for (auto& de : fs::directory_iterator(folder)) {
-        if (!de.is_regular_file()) continue;
-
-        ParsedName pn = parse_folder_filename(de.path());
-        if (!pn.ok) { skipped++; continue; }
-
-        std::vector<uint8_t> fileData;
-        try { fileData = read_file(de.path()); }
-        catch (...) { skipped++; continue; }
-
-        uint64_t key = make_key(pn.hash, pn.type);
-        auto itIdx = key_to_index.find(key);
-        if (itIdx != key_to_index.end()) {
-            int idx = itIdx->second;
-            if (idx >= 0 && idx < (int)items.size()) {
-                items[idx].data = std::move(fileData);
-                updated++;
-            }
-            else {
-                skipped++;
-            }
-        }
-        else {
-            Item ni;
-            ni.hash = pn.hash;
-            ni.type = pn.type;
-            ni.data = std::move(fileData);
-            ni.has_old = false;
-            items.push_back(std::move(ni));
-            key_to_index[key] = (int)items.size() - 1;
-            added++;
-        }
-    }
-
-    log_append("Reimport folder: " + folder.string());
-    log_append("Updated: " + std::to_string(updated) + ", Added: " + std::to_string(added) + ", Skipped: " + std::to_string(skipped));
-
-    // Sort by type then hash
-    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
-        if (a.type != b.type) return a.type < b.type;
-        return a.hash < b.hash;
-        });
-
-    // Rebuild resource_locations
-    P.res_locs.clear();
-    P.res_locs.resize(items.size());
-    for (size_t i = 0; i < items.size(); ++i) {
-        P.res_locs[i].field_0.m_hash.source_hash_code = items[i].hash;
-        P.res_locs[i].field_0.m_type = items[i].type;
-        P.res_locs[i].m_offset = 0;
-        P.res_locs[i].m_size = (uint32_t)items[i].data.size();
-    }
-
-    // Update dir counts + type ranges
-    P.dir.resource_locations.m_size = (uint16_t)P.res_locs.size();
-    for (int t = 0; t < 70; ++t) {
-        P.dir.type_start_idxs[t] = 0;
-        P.dir.type_end_idxs[t] = 0; // COUNT
-    }
-    for (size_t i = 0; i < P.res_locs.size(); ++i) {
-        uint32_t t = P.res_locs[i].field_0.m_type;
-        if (t >= 70) continue;
-
-        if (P.dir.type_end_idxs[t] == 0)
-            P.dir.type_start_idxs[t] = (int32_t)i;
-
-        P.dir.type_end_idxs[t] += 1;
-    }
-
-    // Assign new offsets in payload
-    uint32_t cursor = 0;
-    for (size_t i = 0; i < items.size(); ++i) {
-        cursor = (uint32_t)align_up(cursor, align_val);
-        P.res_locs[i].m_offset = cursor;
-        cursor += (uint32_t)items[i].data.size();
-    }
-
-    // ------------------------------------------------------------------------
-    // NEW: Add TL entries for any newly added resources (if they belong to TL sets)
-    // ------------------------------------------------------------------------
-    auto tl_has = [](const std::vector<tlresource_location>& v, uint32_t h, uint8_t t8) {
-        for (auto& x : v) {
-            if (x.name.source_hash_code == h && x.type == t8) return true;
-        }
-        return false;
-        };
-
-    // Map resource type -> TL vector to update
-    auto tl_vector_for_type = [&](uint32_t rtype) -> std::vector<tlresource_location>*{
-        const char* ext = get_ext(rtype);
-
-        // Pragmatic mapping used by USM packs:
-        if (!strcmp(ext, ".DDS") || !strcmp(ext, ".DDSMP")) return &P.textures;
-
-        if (!strcmp(ext, ".PCMESHDEF")) return &P.mesh_files;
-        if (!strcmp(ext, ".PCMESH"))    return &P.meshes;
-
-        if (!strcmp(ext, ".PCMORPHDEF")) return &P.morph_files;
-        if (!strcmp(ext, ".PCMORPH"))    return &P.morphs;
-
-        if (!strcmp(ext, ".PCMATDEF")) return &P.material_files;
-        if (!strcmp(ext, ".PCMAT"))    return &P.materials;
-
-        if (!strcmp(ext, ".PCANIM"))  return &P.anims;
-        if (!strcmp(ext, ".PCSANIM")) return &P.scene_anims;
-
-        if (!strcmp(ext, ".PCSKEL")) return &P.skeletons;
-
-        return nullptr;
-        };
-
-    // Add TL for new items ONLY
-    for (size_t i = 0; i < items.size(); ++i) {
-        if (items[i].has_old) continue;
-
-        auto* vec = tl_vector_for_type(items[i].type);
-        if (!vec) continue;
-
-        // tlresource_location.type is uint8; in most packs it's the resource type index (truncated).
-        uint8_t t8 = (uint8_t)items[i].type;
-
-        if (tl_has(*vec, items[i].hash, t8))
-            continue;
-
-        tlresource_location tl{};
-        tl.name.source_hash_code = items[i].hash;
-        tl.type = t8;
-        tl.offset = P.res_locs[i].m_offset; // offsets are relative to base/payload
-        vec->push_back(tl);
-    }
-
-    // Keep TL vectors sorted (nice + stable for tools)
-    auto tl_sort = [](std::vector<tlresource_location>& v) {
-        std::sort(v.begin(), v.end(), [](const tlresource_location& a, const tlresource_location& b) {
-            if (a.type != b.type) return a.type < b.type;
-            return a.name.source_hash_code < b.name.source_hash_code;
-            });
-        };
-    tl_sort(P.textures); tl_sort(P.mesh_files); tl_sort(P.meshes);
-    tl_sort(P.morph_files); tl_sort(P.morphs);
-    tl_sort(P.material_files); tl_sort(P.materials);
-    tl_sort(P.anim_files); tl_sort(P.anims);
-    tl_sort(P.scene_anims); tl_sort(P.skeletons);
-
-    // Update TL counts in directory
-    P.dir.texture_locations.m_size = (uint16_t)P.textures.size();
-    P.dir.mesh_file_locations.m_size = (uint16_t)P.mesh_files.size();
-    P.dir.mesh_locations.m_size = (uint16_t)P.meshes.size();
-    P.dir.morph_file_locations.m_size = (uint16_t)P.morph_files.size();
-    P.dir.morph_locations.m_size = (uint16_t)P.morphs.size();
-    P.dir.material_file_locations.m_size = (uint16_t)P.material_files.size();
-    P.dir.material_locations.m_size = (uint16_t)P.materials.size();
-    P.dir.anim_file_locations.m_size = (uint16_t)P.anim_files.size();
-    P.dir.anim_locations.m_size = (uint16_t)P.anims.size();
-    P.dir.scene_anim_locations.m_size = (uint16_t)P.scene_anims.size();
-    P.dir.skeleton_locations.m_size = (uint16_t)P.skeletons.size();
-
-    // ------------------------------------------------------------------------
-    // Remap OLD TL offsets -> NEW (only for existing ones). Newly added TL entries
-    // already point at new offsets.
-    // ------------------------------------------------------------------------
-    auto old_to_new = [&](uint32_t old_off) -> uint32_t {
-        for (size_t i = 0; i < items.size(); ++i) {
-            if (!items[i].has_old) continue;
-            uint32_t rs = items[i].old_off;
-            uint32_t re = rs + items[i].old_size;
-            if (old_off >= rs && old_off < re) {
-                uint32_t h = items[i].hash, t = items[i].type;
-                for (size_t j = 0; j < P.res_locs.size(); ++j) {
-                    if (P.res_locs[j].field_0.m_hash.source_hash_code == h &&
-                        P.res_locs[j].field_0.m_type == t) {
-                        return P.res_locs[j].m_offset + (old_off - rs);
-                    }
-                }
-                return old_off;
-            }
-        }
-        return old_off;
-        };
-
-    auto remap_tl = [&](std::vector<tlresource_location>& v) {
-        for (auto& t : v) {
-            // If this TL points inside an old resource, remap.
-            // If it's new, it won't match any old containment and will remain unchanged.
-            t.offset = old_to_new(t.offset);
-        }
-        };
-    remap_tl(P.textures); remap_tl(P.mesh_files); remap_tl(P.meshes);
-    remap_tl(P.morph_files); remap_tl(P.morphs);
-    remap_tl(P.material_files); remap_tl(P.materials);
-    remap_tl(P.anim_files); remap_tl(P.anims);
-    remap_tl(P.scene_anims); remap_tl(P.skeletons);
-
-    // ------------------------------------------------------------------------
-    // Serialize directory (can grow) -> recompute base/res_dir_mash_size
-    // ------------------------------------------------------------------------
-    std::vector<uint8_t> out;
-    out.resize(sizeof(resource_pack_header), 0);
-
-    resource_pack_header hdr = P.pack_header;
-
-    // safety: directory_offset must be >= header size
-    if (hdr.directory_offset < sizeof(resource_pack_header))
-        hdr.directory_offset = (uint32_t)sizeof(resource_pack_header);
-
-    if (out.size() < hdr.directory_offset)
-        out.resize(hdr.directory_offset, 0);
-
-    out.insert(out.end(), (uint8_t*)&P.mash_header, (uint8_t*)&P.mash_header + sizeof(P.mash_header));
-    out.insert(out.end(), (uint8_t*)&P.dir, (uint8_t*)&P.dir + sizeof(P.dir));
-
-    auto ea = [&](size_t a, uint8_t f = 0xE3) {
-        size_t w = align_up(out.size(), a);
-        if (w > out.size()) out.insert(out.end(), w - out.size(), f);
-        };
-    auto ei = [&](const std::vector<int32_t>& v) {
-        ea(8); ea(4);
-        if (!v.empty()) {
-            auto* p = (const uint8_t*)v.data();
-            out.insert(out.end(), p, p + v.size() * 4);
-        }
-        ea(4);
-        };
-    auto er = [&](const std::vector<resource_location>& v) {
-        ea(8); ea(4);
-        if (!v.empty()) {
-            auto* p = (const uint8_t*)v.data();
-            out.insert(out.end(), p, p + v.size() * sizeof(resource_location));
-        }
-        ea(4);
-        };
-    auto et = [&](const std::vector<tlresource_location>& v) {
-        ea(8); ea(4);
-        if (!v.empty()) {
-            auto* p = (const uint8_t*)v.data();
-            out.insert(out.end(), p, p + v.size() * sizeof(tlresource_location));
-        }
-        ea(4);
-        };
-
-    ei(P.parents);
-    er(P.res_locs);
-    et(P.textures); et(P.mesh_files); et(P.meshes);
-    et(P.morph_files); et(P.morphs);
-    et(P.material_files); et(P.materials);
-    et(P.anim_files); et(P.anims);
-    et(P.scene_anims); et(P.skeletons);
-
-    uint32_t new_base = (uint32_t)align_up(out.size(), 16);
-    if (out.size() < new_base) out.resize(new_base, 0xE3);
-
-    // ------------------------------------------------------------------------
-    // NEW: Patch header/base fields consistently
-    // ------------------------------------------------------------------------
-    hdr.res_dir_mash_size = new_base;  // payload base
-    P.pack_header.res_dir_mash_size = new_base;
-    P.dir.base = (int32_t)new_base;
-
-    // Payload
-    for (size_t i = 0; i < items.size(); ++i) {
-        size_t s = (size_t)new_base + P.res_locs[i].m_offset;
-        size_t need = s + items[i].data.size();
-        if (out.size() < need) out.resize(need, 0);
-        if (!items[i].data.empty())
-            memcpy(&out[s], items[i].data.data(), items[i].data.size());
-    }
-
-    // Patch header at file start (updated base)
-    memcpy(out.data(), &hdr, sizeof(hdr));
-    return out;
+    return write_pack(out_path, P, r.payloads, r.shared.with).size;
 }
 
 // ============================================================================
@@ -908,12 +342,13 @@ struct App {
     HFONT    hFontUI    = nullptr;
     HFONT    hFontMono  = nullptr;
 
-    std::unique_ptr<ParsedPack> pack;
+    std::unique_ptr<LoadedPack> pack;
     bool pack_loaded = false;
 
     // Replacements (index-based build)
     std::unordered_map<int, std::vector<uint8_t>> replacements;
-    int align_val = 16;
+    LayoutOptions layout;   // payload order and alignment when building
+    bool dedupe = false;   // store identical payloads once when building
 
     // Filtered view indices
     std::vector<int> filtered;
@@ -944,17 +379,23 @@ struct App {
         std::string fl = filter_text;
         std::transform(fl.begin(), fl.end(), fl.begin(), ::tolower);
 
-        for (auto& e : pack->entries) {
-            if (type_filter >= 0 && (int)e.type != type_filter) continue;
+        auto consider = [&](const ResourceEntry& e) {
             if (!fl.empty()) {
-                std::string fn = e.filename;
+                std::string fn = entry_filename(e);
                 std::transform(fn.begin(), fn.end(), fn.begin(), ::tolower);
                 std::string hx = format_hex(e.hash);
                 std::transform(hx.begin(), hx.end(), hx.begin(), ::tolower);
                 if (fn.find(fl) == std::string::npos && hx.find(fl) == std::string::npos)
-                    continue;
+                    return;
             }
             filtered.push_back(e.index);
+        };
+        if (type_filter >= 0) {
+            // Only the run of that type, not every entry
+            pack->index.for_each_of_type(pack->res_locs, (uint32_t)type_filter,
+                [&](int i) { consider(pack->entries[i]); });
+        } else {
+            for (auto& e : pack->entries) consider(e);
         }
 
         // Sort
@@ -966,7 +407,7 @@ struct App {
             int cmp = 0;
             switch (sc) {
                 case 0: cmp = ea.index - eb.index; break;
-                case 1: cmp = ea.filename.compare(eb.filename); break;
+                case 1: cmp = entry_filename(ea).compare(entry_filename(eb)); break;
                 case 2: cmp = ea.ext.compare(eb.ext); break;
                 case 3: cmp = (ea.hash < eb.hash) ? -1 : (ea.hash > eb.hash ? 1 : 0); break;
                 case 4: cmp = (ea.offset < eb.offset) ? -1 : (ea.offset > eb.offset ? 1 : 0); break;
@@ -979,6 +420,14 @@ struct App {
         ListView_SetItemCountEx(hList, (int)filtered.size(), LVSICF_NOSCROLL);
     }
 
+    // Called after a dictionary load: cached names are resolved again on demand
+    void forget_names() {
+        if (!pack_loaded) return;
+        for (auto& e : pack->entries) e.filename.clear();
+        rebuild_filtered();
+        ListView_RedrawItems(hList, 0, (int)filtered.size() - 1);
+    }
+
     void update_status() {
         if (!hStatus) return;
         if (pack_loaded) {
@@ -1058,6 +507,12 @@ enum {
     IDM_IMPORT_BUILD,
     IDM_IMPORT_REIMPORT_BUILD, // NEW
     IDM_IMPORT_CLEAR,
+    IDM_IMPORT_DEDUPE,
+    IDM_LAYOUT_ORIGINAL,
+    IDM_LAYOUT_TYPE_HASH,
+    IDM_LAYOUT_SIZE,
+    IDM_LAYOUT_BINPACK,
+    IDM_LAYOUT_ALIGN_2048,
     IDM_CTX_EXPORT,
     IDM_CTX_REPLACE,
     IDM_CTX_REMOVE_REPL,
@@ -1118,13 +573,20 @@ static std::string browse_folder(HWND parent, const char* title) {
 //  Actions
 // ============================================================================
 
+// The open pack stays mapped, so it cannot be the target of a rebuild.
+static void check_not_source(const std::string& out_path) {
+    std::error_code ec;
+    if (g_app.pack_loaded && fs::equivalent(out_path, g_app.pack->source_path, ec))
+        throw std::runtime_error("Cannot overwrite the PCPACK that is currently open. Save to a different file.");
+}
+
 static void action_open_pcpack(HWND hwnd) {
     std::string path = open_file_dialog(hwnd,
         "PCPACK Files\0*.pcpack;*.PCPACK\0All Files\0*.*\0",
         "Open PCPACK File");
     if (path.empty()) return;
     try {
-        g_app.pack = std::make_unique<ParsedPack>(parse_pcpack(path));
+        g_app.pack = std::make_unique<LoadedPack>(load_pack(path));
         g_app.pack_loaded = true;
         g_app.replacements.clear();
         g_app.rebuild_filtered();
@@ -1139,18 +601,19 @@ static void action_open_pcpack(HWND hwnd) {
 
 static void action_load_dict(HWND hwnd) {
     std::string path = open_file_dialog(hwnd,
-        "Dictionary Files\0*.txt\0All Files\0*.*\0",
+        "Dictionary Files\0*.txt;*.bin\0All Files\0*.*\0",
         "Load Hash Dictionary");
     if (path.empty()) return;
-    load_hash_dictionary(path);
+    try {
+        load_hash_dictionary(path);
+    } catch (const std::exception& e) {
+        g_app.add_log("[ERR] ", std::string("Dictionary load failed: ") + e.what());
+        return;
+    }
     g_app.add_log("[OK] ", "Loaded " + std::to_string(g_hashDict.size()) + " hash entries from " + path);
     if (g_app.pack_loaded) {
-        try {
-            g_app.pack = std::make_unique<ParsedPack>(parse_pcpack(g_app.pack->source_path));
-            g_app.rebuild_filtered();
-            g_app.update_info();
-            g_app.add_log("[OK] ", "Re-parsed with dictionary");
-        } catch (...) {}
+        g_app.forget_names();
+        g_app.add_log("[OK] ", "Names will be resolved with the new dictionary");
     }
     g_app.update_status();
 }
@@ -1182,7 +645,7 @@ static void action_export_selected(HWND hwnd) {
         auto& e = g_app.pack->entries[sels[0]];
         std::string path = save_file_dialog(hwnd, "All Files\0*.*\0", "Export Resource", "");
         if (!path.empty()) {
-            try { do_export_single(*g_app.pack, sels[0], path); g_app.add_log("[OK] ", "Exported " + e.filename); }
+            try { do_export_single(*g_app.pack, sels[0], path); g_app.add_log("[OK] ", "Exported " + entry_filename(e)); }
             catch (const std::exception& ex) { g_app.add_log("[ERR] ", ex.what()); }
         }
     } else {
@@ -1191,7 +654,7 @@ static void action_export_selected(HWND hwnd) {
         fs::create_directories(dir);
         int ok = 0;
         for (int idx : sels) {
-            try { do_export_single(*g_app.pack, idx, fs::path(dir) / g_app.pack->entries[idx].filename); ok++; }
+            try { do_export_single(*g_app.pack, idx, fs::path(dir) / entry_filename(g_app.pack->entries[idx])); ok++; }
             catch (...) {}
         }
         g_app.add_log("[OK] ", "Exported " + std::to_string(ok) + "/" + std::to_string(sels.size()) + " to " + dir);
@@ -1204,35 +667,33 @@ static void action_import_files(HWND hwnd) {
     if (path.empty()) return;
     fs::path fp(path);
     std::string fname = fp.filename().string();
-    for (auto& e : g_app.pack->entries) {
-        if (e.filename == fname) {
-            g_app.replacements[e.index] = read_file(fp);
-            g_app.add_log("[OK] ", "Queued [" + std::to_string(e.index) + "] " + fname +
-                " (" + format_size(g_app.replacements[e.index].size()) + ")");
-            g_app.update_status();
-            ListView_RedrawItems(g_app.hList, 0, (int)g_app.filtered.size() - 1);
-            return;
-        }
+    int idx = find_by_filename(*g_app.pack, fp);
+    if (idx < 0) {
+        g_app.add_log("[WARN] ", "No matching resource for: " + fname);
+        return;
     }
-    g_app.add_log("[WARN] ", "No matching resource for: " + fname);
+    g_app.replacements[idx] = read_file(fp);
+    g_app.add_log("[OK] ", "Queued [" + std::to_string(idx) + "] " + fname +
+        " (" + format_size(g_app.replacements[idx].size()) + ")");
+    g_app.update_status();
+    ListView_RedrawItems(g_app.hList, 0, (int)g_app.filtered.size() - 1);
 }
 
 static void action_import_folder(HWND hwnd) {
     if (!g_app.pack_loaded) return;
     std::string dir = browse_folder(hwnd, "Select folder with replacement files");
     if (dir.empty()) return;
-    int count = 0;
+    int count = 0, unchanged = 0;
     for (auto& entry : fs::directory_iterator(dir)) {
         if (!entry.is_regular_file()) continue;
-        std::string fname = entry.path().filename().string();
-        for (auto& e : g_app.pack->entries) {
-            if (e.filename == fname) {
-                g_app.replacements[e.index] = read_file(entry.path());
-                count++; break;
-            }
-        }
+        int idx = find_by_filename(*g_app.pack, entry.path());
+        if (idx < 0) continue;
+        if (same_as_payload(*g_app.pack, idx, entry.path())) { unchanged++; continue; }
+        g_app.replacements[idx] = read_file(entry.path());
+        count++;
     }
-    g_app.add_log("[OK] ", "Found " + std::to_string(count) + " matching files in " + dir);
+    g_app.add_log("[OK] ", "Found " + std::to_string(count) + " changed files in " + dir +
+        " (" + std::to_string(unchanged) + " unchanged)");
     g_app.update_status();
     ListView_RedrawItems(g_app.hList, 0, (int)g_app.filtered.size() - 1);
 }
@@ -1246,12 +707,14 @@ static void action_build(HWND hwnd) {
         "Save rebuilt PCPACK", "PCPACK");
     if (path.empty()) return;
     try {
+        check_not_source(path);
         ParsedPack P = parse_pcpack(g_app.pack->source_path);
-        auto result = do_import(P, g_app.replacements, (size_t)g_app.align_val);
-        write_file(path, result);
-        g_app.add_log("[OK] ", "Built " + path + " (" + format_size(result.size()) + ") with " +
+        std::string layLog;
+        uint64_t size = do_import(P, g_app.replacements, g_app.layout, g_app.dedupe, path, &layLog);
+        g_app.add_log("[OK] ", "Built " + path + " (" + format_size(size) + ") with " +
             std::to_string(g_app.replacements.size()) + " replacement(s)");
-        MessageBoxA(hwnd, ("Built successfully!\n" + path + "\n" + format_size(result.size())).c_str(),
+        if (!layLog.empty()) g_app.add_log("[INFO] ", layLog);
+        MessageBoxA(hwnd, ("Built successfully!\n" + path + "\n" + format_size(size)).c_str(),
             "Build Complete", MB_ICONINFORMATION);
     } catch (const std::exception& e) {
         g_app.add_log("[ERR] ", std::string("Build failed: ") + e.what());
@@ -1271,17 +734,17 @@ static void action_reimport_build(HWND hwnd) {
     if (outPath.empty()) return;
 
     try {
+        check_not_source(outPath);
         ParsedPack P = parse_pcpack(g_app.pack->source_path);
 
         std::string repLog;
-        auto result = do_reimport_from_folder(P, dir, (size_t)g_app.align_val, &repLog);
-        write_file(outPath, result);
+        uint64_t size = do_reimport_from_folder(P, dir, g_app.layout, g_app.dedupe, outPath, &repLog);
 
-        g_app.add_log("[OK] ", "Reimport build OK: " + outPath + " (" + format_size(result.size()) + ")");
+        g_app.add_log("[OK] ", "Reimport build OK: " + outPath + " (" + format_size(size) + ")");
         if (!repLog.empty()) g_app.add_log("[INFO] ", repLog);
 
         MessageBoxA(hwnd,
-            ("Reimport build complete!\n\nOutput:\n" + outPath + "\n\nSize: " + format_size(result.size())).c_str(),
+            ("Reimport build complete!\n\nOutput:\n" + outPath + "\n\nSize: " + format_size(size)).c_str(),
             "Reimport Build Complete", MB_ICONINFORMATION);
     } catch (const std::exception& e) {
         g_app.add_log("[ERR] ", std::string("Reimport build failed: ") + e.what());
@@ -1304,7 +767,7 @@ static void handle_drop(HWND hwnd, HDROP hDrop) {
 
         if (upper.size() > 7 && upper.substr(upper.size() - 7) == ".PCPACK") {
             try {
-                g_app.pack = std::make_unique<ParsedPack>(parse_pcpack(sp));
+                g_app.pack = std::make_unique<LoadedPack>(load_pack(sp));
                 g_app.pack_loaded = true;
                 g_app.replacements.clear();
                 g_app.rebuild_filtered();
@@ -1315,29 +778,25 @@ static void handle_drop(HWND hwnd, HDROP hDrop) {
                 g_app.add_log("[ERR] ", std::string("Load failed: ") + e.what());
             }
         }
-        else if (upper.size() > 4 && upper.substr(upper.size() - 4) == ".TXT") {
-            load_hash_dictionary(sp);
-            g_app.add_log("[OK] ", "Loaded " + std::to_string(g_hashDict.size()) + " hash entries");
-            if (g_app.pack_loaded) {
-                try {
-                    g_app.pack = std::make_unique<ParsedPack>(parse_pcpack(g_app.pack->source_path));
-                    g_app.rebuild_filtered();
-                    g_app.update_info();
-                } catch (...) {}
+        else if (upper.size() > 4 && (upper.substr(upper.size() - 4) == ".TXT" || upper.substr(upper.size() - 4) == ".BIN")) {
+            try {
+                load_hash_dictionary(sp);
+            } catch (const std::exception& e) {
+                g_app.add_log("[ERR] ", std::string("Dictionary load failed: ") + e.what());
+                continue;
             }
+            g_app.add_log("[OK] ", "Loaded " + std::to_string(g_hashDict.size()) + " hash entries");
+            if (g_app.pack_loaded) g_app.forget_names();
             g_app.update_status();
         }
         else if (g_app.pack_loaded) {
             fs::path fp(sp);
-            std::string fname = fp.filename().string();
-            for (auto& e : g_app.pack->entries) {
-                if (e.filename == fname) {
-                    g_app.replacements[e.index] = read_file(fp);
-                    g_app.add_log("[OK] ", "Queued replacement [" + std::to_string(e.index) + "] " + fname);
-                    g_app.update_status();
-                    ListView_RedrawItems(g_app.hList, 0, (int)g_app.filtered.size() - 1);
-                    break;
-                }
+            int idx = find_by_filename(*g_app.pack, fp);
+            if (idx >= 0) {
+                g_app.replacements[idx] = read_file(fp);
+                g_app.add_log("[OK] ", "Queued replacement [" + std::to_string(idx) + "] " + fp.filename().string());
+                g_app.update_status();
+                ListView_RedrawItems(g_app.hList, 0, (int)g_app.filtered.size() - 1);
             }
         }
     }
@@ -1367,6 +826,18 @@ static HMENU create_menu() {
     AppendMenuA(hImport, MF_STRING, IDM_IMPORT_BUILD,          "Build PCPACK...");
     AppendMenuA(hImport, MF_STRING, IDM_IMPORT_REIMPORT_BUILD, "Reimport (Folder Sync + Reorder) -> Build...");
     AppendMenuA(hImport, MF_STRING, IDM_IMPORT_CLEAR,          "Clear All Replacements");
+    AppendMenuA(hImport, MF_SEPARATOR, 0, nullptr);
+    AppendMenuA(hImport, MF_STRING, IDM_IMPORT_DEDUPE,         "Deduplicate Identical Payloads");
+
+    HMENU hLayout = CreatePopupMenu();
+    AppendMenuA(hLayout, MF_STRING, IDM_LAYOUT_ORIGINAL,   "Original Order");
+    AppendMenuA(hLayout, MF_STRING, IDM_LAYOUT_TYPE_HASH,  "Type then Hash");
+    AppendMenuA(hLayout, MF_STRING, IDM_LAYOUT_SIZE,       "Size Buckets");
+    AppendMenuA(hLayout, MF_STRING, IDM_LAYOUT_BINPACK,    "Bin Pack Small Payloads");
+    AppendMenuA(hLayout, MF_SEPARATOR, 0, nullptr);
+    AppendMenuA(hLayout, MF_STRING, IDM_LAYOUT_ALIGN_2048, "Align Large Payloads to 2048 Bytes");
+    CheckMenuRadioItem(hLayout, IDM_LAYOUT_ORIGINAL, IDM_LAYOUT_BINPACK, IDM_LAYOUT_ORIGINAL, MF_BYCOMMAND);
+    AppendMenuA(hImport, MF_POPUP, (UINT_PTR)hLayout, "Payload Layout");
     AppendMenuA(hMenu, MF_POPUP, (UINT_PTR)hImport, "Import");
 
     return hMenu;
@@ -1512,10 +983,10 @@ static void on_lv_getdispinfo(NMLVDISPINFOA* di) {
             case 0: snprintf(buf, sizeof(buf), "%d", e.index); break;
             case 1:
                 if (g_app.replacements.count(idx))
-                    snprintf(buf, sizeof(buf), "%s  [%s]", e.filename.c_str(),
+                    snprintf(buf, sizeof(buf), "%s  [%s]", entry_filename(e).c_str(),
                         format_size(g_app.replacements[idx].size()).c_str());
                 else
-                    snprintf(buf, sizeof(buf), "%s", e.filename.c_str());
+                    snprintf(buf, sizeof(buf), "%s", entry_filename(e).c_str());
                 break;
             case 2: snprintf(buf, sizeof(buf), "%s", e.ext.c_str()); break;
             case 3: snprintf(buf, sizeof(buf), "%s", format_hex(e.hash).c_str()); break;
@@ -1593,7 +1064,7 @@ static void on_lv_rclick(HWND hwnd) {
     if (cmd == IDM_CTX_EXPORT) {
         std::string path = save_file_dialog(hwnd, "All Files\0*.*\0", "Export Resource", "");
         if (!path.empty()) {
-            try { do_export_single(*g_app.pack, idx, path); g_app.add_log("[OK] ", "Exported " + e.filename); }
+            try { do_export_single(*g_app.pack, idx, path); g_app.add_log("[OK] ", "Exported " + entry_filename(e)); }
             catch (const std::exception& ex) { g_app.add_log("[ERR] ", ex.what()); }
         }
     } else if (cmd == IDM_CTX_REPLACE) {
@@ -1659,6 +1130,30 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                 g_app.update_status();
                 ListView_RedrawItems(g_app.hList, 0, (int)g_app.filtered.size() - 1);
                 break;
+            case IDM_IMPORT_DEDUPE:
+                g_app.dedupe = !g_app.dedupe;
+                CheckMenuItem(GetMenu(hwnd), IDM_IMPORT_DEDUPE, g_app.dedupe ? MF_CHECKED : MF_UNCHECKED);
+                g_app.add_log("[INFO] ", g_app.dedupe ? "Identical payloads will be stored once" :
+                                                        "Identical payloads will be stored separately");
+                break;
+            case IDM_LAYOUT_ORIGINAL:
+            case IDM_LAYOUT_TYPE_HASH:
+            case IDM_LAYOUT_SIZE:
+            case IDM_LAYOUT_BINPACK:
+                g_app.layout.layout = (PayloadLayout)(id - IDM_LAYOUT_ORIGINAL);
+                CheckMenuRadioItem(GetMenu(hwnd), IDM_LAYOUT_ORIGINAL, IDM_LAYOUT_BINPACK, id, MF_BYCOMMAND);
+                g_app.add_log("[INFO] ", std::string("Payload layout: ") + layout_names[g_app.layout.layout]);
+                break;
+            case IDM_LAYOUT_ALIGN_2048: {
+                // Small payloads keep the game's 16 byte alignment and fill the gaps
+                bool large = g_app.layout.align == 16;
+                g_app.layout.align = large ? 2048 : 16;
+                g_app.layout.small_align = large ? 16 : 0;
+                CheckMenuItem(GetMenu(hwnd), IDM_LAYOUT_ALIGN_2048, large ? MF_CHECKED : MF_UNCHECKED);
+                g_app.add_log("[INFO] ", large ? "Payloads of 2048 bytes or more aligned to 2048, others to 16" :
+                                                 "All payloads aligned to 16");
+                break;
+            }
         }
         return 0;
     }
@@ -1691,7 +1186,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                     auto& e = g_app.pack->entries[idx];
                     std::string path = save_file_dialog(hwnd, "All Files\0*.*\0", "Export Resource", "");
                     if (!path.empty()) {
-                        try { do_export_single(*g_app.pack, idx, path); g_app.add_log("[OK] ", "Exported " + e.filename); }
+                        try { do_export_single(*g_app.pack, idx, path); g_app.add_log("[OK] ", "Exported " + entry_filename(e)); }
                         catch (const std::exception& ex) { g_app.add_log("[ERR] ", ex.what()); }
                     }
                 }
@@ -1801,7 +1296,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow
         std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
         if (upper.find(".PCPACK") != std::string::npos) {
             try {
-                g_app.pack = std::make_unique<ParsedPack>(parse_pcpack(arg));
+                g_app.pack = std::make_unique<LoadedPack>(load_pack(arg));
                 g_app.pack_loaded = true;
                 g_app.rebuild_filtered();
                 g_app.update_status();
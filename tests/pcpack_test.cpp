@@ -0,0 +1,533 @@
+// pcpack_test.cpp - unit tests for libpcpack
+// Checks the invariants the fast paths promise against their simple
+// definitions: bulk hashing, the offset remap, the layout planner, directory
+// serialization and lookup, the pack writer and compiled dictionary checks.
+// Exits non-zero when any check fails.
+//
+// Run: ctest --test-dir build
+
+#include "libpcpack/pcpack.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pcpack;
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                            \
+        }                                                                            \
+    } while (0)
+
+static std::vector<uint8_t> read_file(const fs::path& path) {
+    std::ifstream f(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+// Directory of a small pack shaped like the game's: resources sorted by type
+// then hash with type ranges filled in, and TL entry k of every resource k
+// (round robin over five TL vectors). Offsets are left to the caller.
+static ParsedPack make_directory(std::mt19937& rng, size_t count) {
+    static const uint32_t types[] = { 1, 2, 6, 19, 21, 23, 35 };
+    ParsedPack P;
+    P.res_locs.resize(count);
+    for (auto& rl : P.res_locs) {
+        rl.field_0.m_hash.source_hash_code = rng();
+        rl.field_0.m_type = types[rng() % (sizeof(types) / sizeof(types[0]))];
+        rl.m_size = rng() % 8 == 0 ? 0 : 1 + rng() % (rng() % 4 == 0 ? 20000 : 600);
+    }
+    std::sort(P.res_locs.begin(), P.res_locs.end(), [](const resource_location& a, const resource_location& b) {
+        if (a.field_0.m_type != b.field_0.m_type) return a.field_0.m_type < b.field_0.m_type;
+        return a.field_0.m_hash.source_hash_code < b.field_0.m_hash.source_hash_code;
+    });
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t t = P.res_locs[i].field_0.m_type;
+        if (P.dir.type_end_idxs[t] == 0) P.dir.type_start_idxs[t] = (int32_t)i;
+        P.dir.type_end_idxs[t] += 1;  // COUNT
+    }
+    
+    std::vector<tlresource_location>* tl_vecs[] = { &P.textures, &P.meshes, &P.materials, &P.anims, &P.skeletons };
+    for (size_t k = 0; k < count; ++k) {
+        tlresource_location tl{};
+        tl.name.source_hash_code = rng();
+        tl.type = (uint8_t)P.res_locs[k].field_0.m_type;
+        tl_vecs[k % 5]->push_back(tl);
+    }
+    
+    P.parents = { 0 };
+    P.dir.parents.m_size = 1;
+    P.dir.resource_locations.m_size = (uint16_t)P.res_locs.size();
+    P.dir.texture_locations.m_size = (uint16_t)P.textures.size();
+    P.dir.mesh_locations.m_size = (uint16_t)P.meshes.size();
+    P.dir.material_locations.m_size = (uint16_t)P.materials.size();
+    P.dir.anim_locations.m_size = (uint16_t)P.anims.size();
+    P.dir.skeleton_locations.m_size = (uint16_t)P.skeletons.size();
+    P.pack_header.field_14 = 0x14;
+    P.pack_header.directory_offset = 0x30;
+    
+    uint32_t base = (uint32_t)align_up(serialize_directory(P).size(), 16);
+    P.pack_header.res_dir_mash_size = base;
+    P.dir.base = (int32_t)base;
+    P.mash_header.field_8 = (int32_t)(base - P.pack_header.directory_offset);
+    return P;
+}
+
+// Points every TL entry somewhere inside the payload of its resource
+static void place_tl_entries(ParsedPack& P, std::mt19937& rng) {
+    std::vector<tlresource_location>* tl_vecs[] = { &P.textures, &P.meshes, &P.materials, &P.anims, &P.skeletons };
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        auto& tl = (*tl_vecs[i % 5])[i / 5];
+        tl.offset = rl.m_offset + (rl.m_size ? rng() % rl.m_size : 0);
+    }
+}
+
+static void test_hash_strings() {
+    std::mt19937 rng(1);
+    std::vector<std::string> names = { "", "a", "A", "CHAR_SPIDERMAN", "char_spiderman", "levels\\city\\block_07" };
+    for (int i = 0; i < 500; ++i) {
+        std::string s(rng() % 70, ' ');
+        for (char& c : s) c = (char)(32 + rng() % 95);
+        names.push_back(s);
+    }
+    std::vector<std::string_view> views(names.begin(), names.end());
+    std::vector<uint32_t> bulk(views.size());
+    hash_strings(views.data(), views.size(), bulk.data());
+    for (size_t i = 0; i < views.size(); ++i) CHECK(bulk[i] == hash_string(views[i]));
+    CHECK(hash_string("CHAR_SPIDERMAN") == hash_string("char_spiderman"));
+}
+
+static void test_offset_remap() {
+    std::mt19937 rng(2);
+    for (int round = 0; round < 20; ++round) {
+        // Back to back payloads with gaps, some aliased to the previous start;
+        // from round 10 on some also reach over the following ones
+        struct Old { uint32_t start, size, new_start; };
+        std::vector<Old> old;
+        uint32_t cursor = 0, new_cursor = 0;
+        for (int i = 0; i < 300; ++i) {
+            uint32_t size = rng() % 10 == 0 ? 0 : 1 + rng() % 3000;
+            if (!old.empty() && rng() % 8 == 0) {
+                size = old.back().size;
+                old.push_back({ old.back().start, size, new_cursor });
+            } else {
+                cursor = (uint32_t)align_up(cursor + rng() % 64, 16);
+                old.push_back({ cursor, size, new_cursor });
+                cursor += size;
+            }
+            new_cursor = (uint32_t)align_up(new_cursor + size, 2048);
+        }
+        if (round >= 10) {
+            for (auto& o : old) {
+                if (rng() % 6 == 0) o.size += rng() % 20000;
+            }
+        }
+        std::vector<size_t> order(old.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+    
+        OffsetRemap remap;
+        for (size_t i : order) remap.add(old[i].start, old[i].size, old[i].new_start);
+        remap.finish();
+    
+        for (uint32_t off = 0; off < cursor + 20100; off += 1 + rng() % 7) {
+            uint32_t expected = off;
+            for (size_t i : order) {
+                if (off >= old[i].start && off < old[i].start + old[i].size) {
+                    expected = old[i].new_start + (off - old[i].start);
+                    break;
+                }
+            }
+            CHECK(remap.map(off) == expected);
+        }
+    }
+    
+    // A=[0x0,0x100) contains B=[0x50,0x60), added after it
+    OffsetRemap nested;
+    nested.add(0x0, 0x100, 0x1000);
+    nested.add(0x50, 0x10, 0x2000);
+    nested.finish();
+    CHECK(nested.map(0x55) == 0x1055);
+    CHECK(nested.map(0x70) == 0x1070);
+    CHECK(nested.map(0x100) == 0x100);
+}
+
+static void test_layouts() {
+    std::mt19937 rng(3);
+    for (size_t align : { (size_t)16, (size_t)2048 }) {
+        for (size_t small_align : { (size_t)0, (size_t)16 }) {
+            std::vector<LayoutItem> items(400);
+            std::vector<int> shared(items.size(), -1);
+            for (size_t i = 0; i < items.size(); ++i) {
+                items[i] = { rng() % 5 == 0 ? 0u : (uint32_t)(1 + rng() % 5000), (uint32_t)(rng() % 7), (uint32_t)rng() };
+                if (i > 0 && rng() % 10 == 0) {
+                    shared[i] = (int)(rng() % i);
+                    if (shared[shared[i]] >= 0) shared[i] = shared[shared[i]];
+                    items[i].size = items[shared[i]].size;
+                }
+            }
+            size_t small = small_align ? small_align : align;
+    
+            for (PayloadLayout layout : { LAYOUT_ORIGINAL, LAYOUT_TYPE_HASH, LAYOUT_SIZE, LAYOUT_BINPACK }) {
+                LayoutPlan plan = plan_payload_layout(items, shared, layout, align, small_align);
+                CHECK(plan.offsets.size() == items.size());
+    
+                std::vector<std::pair<uint64_t, uint64_t>> spans;
+                uint64_t used = 0;
+                for (size_t i = 0; i < items.size(); ++i) {
+                    uint64_t at = plan.offsets[i];
+                    CHECK(at % (items[i].size < align ? small : align) == 0);
+                    CHECK(at + items[i].size <= plan.end);
+                    if (shared[i] >= 0) {
+                        CHECK(at == plan.offsets[shared[i]]);
+                    } else {
+                        spans.push_back({ at, at + items[i].size });
+                        used += items[i].size;
+                    }
+                }
+                std::sort(spans.begin(), spans.end());
+                for (size_t k = 1; k < spans.size(); ++k) CHECK(spans[k - 1].second <= spans[k].first);
+                CHECK(plan.end == used + plan.padding);
+            }
+        }
+    }
+}
+
+static void test_directory_round_trip() {
+    std::mt19937 rng(4);
+    ParsedPack P = make_directory(rng, 250);
+    uint32_t cursor = 0;
+    for (auto& rl : P.res_locs) {
+        rl.m_offset = cursor;
+        cursor = (uint32_t)align_up(cursor + rl.m_size, 16);
+    }
+    place_tl_entries(P, rng);
+    
+    std::vector<uint8_t> head = serialize_directory(P);
+    CHECK(head.size() == P.base());
+    
+    ParsedPack Q;
+    parse_directory(Q, head.data(), head.size());
+    CHECK(serialize_directory(Q) == head);
+    CHECK(Q.res_locs.size() == P.res_locs.size());
+    CHECK(Q.textures.size() == P.textures.size() && Q.skeletons.size() == P.skeletons.size());
+    CHECK(Q.base() == P.base());
+    for (size_t i = 0; i < P.res_locs.size(); ++i) {
+        const auto& rl = P.res_locs[i];
+        CHECK(Q.find(rl.field_0.m_hash.source_hash_code, rl.field_0.m_type) == (int)i);
+        CHECK(Q.res_locs[i].m_offset == rl.m_offset && Q.res_locs[i].m_size == rl.m_size);
+    }
+}
+
+static void test_duplicate_keys() {
+    // Types 2 and 6, hash 0x20 twice in type 6
+    std::vector<resource_location> locs(5);
+    const uint32_t keys[5][2] = { { 2, 0x10 }, { 6, 0x05 }, { 6, 0x20 }, { 6, 0x20 }, { 6, 0x30 } };
+    for (size_t i = 0; i < locs.size(); ++i) {
+        locs[i].field_0.m_type = keys[i][0];
+        locs[i].field_0.m_hash.source_hash_code = keys[i][1];
+    }
+    resource_directory dir{};
+    dir.type_start_idxs[2] = 0; dir.type_end_idxs[2] = 1;
+    dir.type_start_idxs[6] = 1; dir.type_end_idxs[6] = 4;
+    
+    ResourceIndex ranged;
+    ranged.build(locs, dir);
+    CHECK(ranged.ranged);
+    
+    // The same entries out of order only get the sorted fallback
+    std::swap(locs[0], locs[4]);
+    ResourceIndex sorted;
+    sorted.build(locs, dir);
+    CHECK(!sorted.ranged);
+    std::swap(locs[0], locs[4]);
+    
+    CHECK(ranged.find(locs, 0x20, 6) == 3);
+    CHECK(ranged.find_first(locs, 0x20, 6) == 2);
+    CHECK(ranged.find_first(locs, 0x10, 2) == 0);
+    CHECK(ranged.find_first(locs, 0x31, 6) == -1 && ranged.find_first(locs, 0x01, 6) == -1);
+    
+    std::swap(locs[0], locs[4]);
+    CHECK(sorted.find(locs, 0x20, 6) == 3);
+    CHECK(sorted.find_first(locs, 0x20, 6) == 2);
+    CHECK(sorted.find_first(locs, 0x10, 2) == 4);
+    CHECK(sorted.find_first(locs, 0x30, 6) == 0);
+    CHECK(sorted.find_first(locs, 0x20, 2) == -1 && sorted.find(locs, 0x20, 2) == -1);
+}
+
+static void test_write_pack(const fs::path& dir) {
+    std::mt19937 rng(5);
+    ParsedPack P = make_directory(rng, 200);
+    
+    std::vector<LayoutItem> items;
+    for (const auto& rl : P.res_locs) items.push_back({ rl.m_size, rl.field_0.m_type, rl.field_0.m_hash.source_hash_code });
+    std::vector<int> none(items.size(), -1);
+    LayoutPlan plan = plan_payload_layout(items, none, LAYOUT_BINPACK, 2048, 16);
+    for (size_t i = 0; i < P.res_locs.size(); ++i) P.res_locs[i].m_offset = plan.offsets[i];
+    place_tl_entries(P, rng);
+    
+    // The pack as it must come out: directory, zero padding, payloads
+    std::vector<std::vector<uint8_t>> data(P.res_locs.size());
+    std::vector<uint8_t> expected = serialize_directory(P);
+    expected.resize(P.base() + plan.end, 0);
+    std::vector<PayloadSource> payloads(P.res_locs.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i].resize(P.res_locs[i].m_size);
+        for (auto& b : data[i]) b = (uint8_t)rng();
+        std::copy(data[i].begin(), data[i].end(), expected.begin() + P.base() + P.res_locs[i].m_offset);
+        payloads[i].bytes = { data[i].data(), data[i].size() };
+        payloads[i].size = data[i].size();
+    }
+    
+    fs::path first = dir / "first.PCPACK";
+    fs::path second = dir / "second.PCPACK";
+    WriteStats st = write_pack(first, P, payloads, none);
+    CHECK(st.size == expected.size());
+    CHECK(read_file(first) == expected);
+    
+    // Rebuilding with every payload kept reproduces the pack byte for byte
+    ParsedPack R = parse_pcpack(first);
+    std::vector<PayloadSource> kept;
+    for (size_t i = 0; i < R.res_locs.size(); ++i) kept.push_back(kept_payload(R, i));
+    SharedPayloads shared = find_shared_payloads(kept, false);
+    write_pack(second, R, kept, shared.with);
+    CHECK(read_file(second) == expected);
+    
+    R.raw = MappedFile();
+    fs::remove(first);
+    fs::remove(second);
+}
+
+// An empty payload planned at the offset of a non-empty one with a lower
+// index (type/hash order puts it first) is not an overlap
+static void test_write_empty_payloads(const fs::path& dir) {
+    std::mt19937 rng(6);
+    ParsedPack P = make_directory(rng, 2);
+    P.res_locs[0].field_0 = { { 9 }, 1 };
+    P.res_locs[0].m_size = 20;
+    P.res_locs[1].field_0 = { { 7 }, 1 };
+    P.res_locs[1].m_size = 0;
+    
+    std::vector<LayoutItem> items = { { 20, 1, 9 }, { 0, 1, 7 } };
+    std::vector<int> none(items.size(), -1);
+    for (PayloadLayout layout : { LAYOUT_ORIGINAL, LAYOUT_TYPE_HASH, LAYOUT_SIZE, LAYOUT_BINPACK }) {
+        LayoutPlan plan = plan_payload_layout(items, none, layout, 16, 0);
+        if (layout == LAYOUT_TYPE_HASH) CHECK(plan.offsets[0] == 0 && plan.offsets[1] == 0);
+        for (size_t i = 0; i < items.size(); ++i) P.res_locs[i].m_offset = plan.offsets[i];
+        
+        std::vector<uint8_t> data(20, 0xAB);
+        std::vector<PayloadSource> payloads(2);
+        payloads[0].bytes = { data.data(), data.size() };
+        payloads[0].size = data.size();
+        payloads[1].bytes = { data.data(), 0 };
+        
+        fs::path out = dir / "empty.PCPACK";
+        uint64_t end = P.base() + std::max<uint64_t>(plan.offsets[0] + 20, plan.offsets[1]);
+        try {
+            WriteStats st = write_pack(out, P, payloads, none);
+            std::vector<uint8_t> bytes = read_file(out);
+            CHECK(st.size == end && bytes.size() == end);
+            CHECK(std::equal(data.begin(), data.end(), bytes.begin() + P.base() + plan.offsets[0]));
+        } catch (const std::runtime_error& e) {
+            fprintf(stderr, "write_pack (%s): %s\n", layout_names[layout], e.what());
+            CHECK(!"write_pack threw");
+        }
+        fs::remove(out);
+    }
+}
+
+// Overwrites the 32-bit value at byte pos of a file
+static void patch_u32(const fs::path& path, size_t pos, uint32_t value) {
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp((std::streamoff)pos);
+    f.write((const char*)&value, sizeof(value));
+}
+
+static void test_compiled_dictionary(const fs::path& dir) {
+    fs::path txt = dir / "dict.txt";
+    fs::path bin = dir / "dict.bin";
+    {
+        std::ofstream f(txt, std::ios::binary);
+        f << "0x00000ce4\tAC\n0x00000010\tBIP01 NECK1\n0x00000200\tCHAR_SPIDERMAN\n";
+    }
+    HashDictionary d;
+    load_text_dictionary(d, txt);
+    write_compiled_dictionary(d, bin);
+    
+    HashDictionary c;
+    load_dictionary(c, bin);
+    CHECK(c.size() == 3);
+    CHECK(c.find(0xce4) && std::string(c.find(0xce4)) == "AC");
+    CHECK(c.find(0x10) && std::string(c.find(0x10)) == "BIP01 NECK1");
+    c = HashDictionary();
+    
+    auto rejected = [&] {
+        HashDictionary bad;
+        try { load_compiled_dictionary(bad, bin); } catch (const std::runtime_error&) { return true; }
+        return false;
+    };
+    const size_t hashes = sizeof(dict_file_header), offsets = hashes + 3 * 4;
+    patch_u32(bin, offsets + 4, 0xFFFF);   // name past the blob
+    CHECK(rejected());
+    write_compiled_dictionary(d, bin);
+    patch_u32(bin, hashes + 4, 0x10);      // duplicate hash
+    CHECK(rejected());
+    write_compiled_dictionary(d, bin);
+    patch_u32(bin, hashes, 0x300);         // out of order
+    CHECK(rejected());
+    
+    fs::remove(txt);
+    fs::remove(bin);
+}
+
+// A small valid pack with random payloads; returns its directory
+static ParsedPack write_small_pack(const fs::path& path, uint32_t seed, size_t count) {
+    std::mt19937 rng(seed);
+    ParsedPack P = make_directory(rng, count);
+    uint32_t cursor = 0;
+    for (auto& rl : P.res_locs) {
+        rl.m_offset = cursor;
+        cursor = (uint32_t)align_up(cursor + rl.m_size, 16);
+    }
+    place_tl_entries(P, rng);
+    std::vector<uint8_t> data(cursor);
+    for (auto& b : data) b = (uint8_t)rng();
+    std::vector<PayloadSource> payloads(P.res_locs.size());
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        payloads[i].bytes = { data.data() + P.res_locs[i].m_offset, P.res_locs[i].m_size };
+        payloads[i].size = P.res_locs[i].m_size;
+    }
+    write_pack(path, P, payloads, std::vector<int>(payloads.size(), -1));
+    return P;
+}
+
+static bool run_tool(const std::string& tool, const std::string& args) {
+    std::string cmd = "\"" + tool + "\" " + args;
+    return std::system(cmd.c_str()) == 0;
+}
+
+static std::string quoted(const fs::path& p) { return "\"" + p.string() + "\""; }
+
+// read_pack_directory must see the same directory as the mapped parse and
+// never read past it, whatever the header claims as base
+static void test_read_pack_directory(const fs::path& dir) {
+    fs::path path = dir / "directory.PCPACK";
+    write_small_pack(path, 13, 60);
+    ParsedPack M = parse_pcpack(path);
+    ParsedPack R = read_pack_directory(path);
+    CHECK(R.raw.size() == 0);
+    CHECK(serialize_directory(R) == serialize_directory(M));
+    M.raw = MappedFile();
+    
+    patch_u32(path, offsetof(resource_pack_header, res_dir_mash_size), 0xFFFFFFF0);
+    ParsedPack C = read_pack_directory(path);
+    CHECK(C.res_locs.size() == 60);
+    
+    patch_u32(path, offsetof(resource_pack_header, directory_offset), 0x7FFFFFF0);
+    bool threw = false;
+    try { read_pack_directory(path); } catch (const std::runtime_error&) { threw = true; }
+    CHECK(threw);
+    fs::remove(path);
+}
+
+// Rebuilding a catalog over one from another folder, or over a damaged one,
+// must start from scratch rather than reuse its entries
+static void test_catalog_rebuild(const fs::path& dir, const std::string& tool) {
+    fs::path a = dir / "catalog_a", b = dir / "catalog_b", cat = dir / "test.pcct";
+    fs::remove_all(a);
+    fs::remove_all(b);
+    fs::create_directories(a);
+    fs::create_directories(b);
+    write_small_pack(a / "ONE.PCPACK", 10, 40);
+    write_small_pack(a / "TWO.PCPACK", 11, 40);
+    ParsedPack B = write_small_pack(b / "THREE.PCPACK", 12, 30);
+    char key[16];
+    snprintf(key, sizeof(key), "0x%08X", B.res_locs[0].field_0.m_hash.source_hash_code);
+    fs::remove(cat);
+    
+    CHECK(run_tool(tool, "catalog build " + quoted(a) + " " + quoted(cat)));
+    CHECK(run_tool(tool, "catalog build " + quoted(b) + " " + quoted(cat)));
+    CHECK(run_tool(tool, "catalog find " + quoted(cat) + " " + key));
+    
+    // Entry 0 names a pack past the table
+    uint32_t pack_count = 0;
+    {
+        std::ifstream f(cat, std::ios::binary);
+        f.seekg(8);
+        f.read((char*)&pack_count, sizeof(pack_count));
+    }
+    const size_t header = 0x18, pack_size = 0x20;
+    patch_u32(cat, header + pack_count * pack_size + 8, pack_count + 5);
+    CHECK(!run_tool(tool, "catalog find " + quoted(cat) + " " + key));
+    CHECK(run_tool(tool, "catalog build " + quoted(b) + " " + quoted(cat)));
+    CHECK(run_tool(tool, "catalog find " + quoted(cat) + " " + key));
+    
+    fs::remove_all(a);
+    fs::remove_all(b);
+    fs::remove(cat);
+}
+
+// Crack only writes the dictionary when asked to: brute force also finds
+// collisions, which must not end up there by default
+static void test_crack_write(const fs::path& dir, const std::string& tool) {
+    fs::path pack = dir / "CRACK.PCPACK", dict = dir / "crack_dict.txt";
+    ParsedPack P = write_small_pack(pack, 14, 20);
+    
+    // Rename resource 0 to a short name brute force reaches at once
+    uint32_t old_hash = P.res_locs[0].field_0.m_hash.source_hash_code;
+    std::vector<uint8_t> raw = read_file(pack);
+    size_t pos = 0x2C;
+    while (pos + 4 <= raw.size() && memcmp(raw.data() + pos, &old_hash, 4) != 0) pos += 4;
+    CHECK(pos + 4 <= raw.size());
+    patch_u32(pack, pos, hash_string("QZ"));
+    { std::ofstream f(dict, std::ios::binary); }
+    
+    std::string args = "crack " + quoted(pack) + " --dict " + quoted(dict) + " --max-len 2 --jobs 1";
+    CHECK(run_tool(tool, args));
+    CHECK(fs::file_size(dict) == 0);
+    CHECK(run_tool(tool, args + " --write"));
+    HashDictionary d;
+    load_text_dictionary(d, dict);
+    CHECK(d.find(hash_string("QZ")) != nullptr);
+    
+    fs::remove(pack);
+    fs::remove(dict);
+}
+
+// pcpack_test [work_dir] [pcpacktool]: the second argument adds the tests
+// that drive the command line tool
+int main(int argc, char** argv) {
+    fs::path dir = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path();
+    fs::create_directories(dir);
+    try {
+        test_hash_strings();
+        test_offset_remap();
+        test_layouts();
+        test_directory_round_trip();
+        test_duplicate_keys();
+        test_write_pack(dir);
+        test_write_empty_payloads(dir);
+        test_compiled_dictionary(dir);
+        test_read_pack_directory(dir);
+        if (argc > 2) test_catalog_rebuild(dir, argv[2]);
+        if (argc > 2) test_crack_write(dir, argv[2]);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    if (g_failures) {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}